@@ -2,6 +2,13 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <limits.h>
+#include <string.h>
+#include <pthread.h>   // The Boruvka and Kruskal engines use threads, so compile with -pthread
+#include <stdatomic.h>
+#include <unistd.h>
+#if defined(__AVX2__) || defined(__SSE4_1__)
+#include <immintrin.h> // Vector min-scan for the dense engine, enable with -mavx2 or -msse4.1
+#endif
 
 #define INF INT_MAX // This is infinity incase the nodes dont connect
 
@@ -11,74 +18,88 @@ struct Edge {
     int length;  
 };
 
+// The Graph object stores every adjacency list back to back in compressed sparse row form
+// The edges leaving vertex u are edges[offsets[u]] up to (but not including) edges[offsets[u + 1]]
+struct Graph {
+    int num_vertices;
+    int *offsets;
+    struct Edge *edges;
+};
+
+// A WeightedEdge object is one undirected edge with both endpoints, used by the edge-based engines
+struct WeightedEdge {
+    int u;
+    int v;
+    int length;
+};
+
+#ifndef HEAP_ARITY
+#define HEAP_ARITY 4 // Number of children per heap node, pick another with -DHEAP_ARITY=n
+#endif
+
 // A MinHeapNode object contains a vertex and its currently known shortest distance from the source vertex
+// The nodes are stored by value inside the heap array, so comparisons never chase a pointer
 struct MinHeapNode {
-    int v;    
     int dist;
+    int v;    
 };
 
-// A MinHeap object contains a MinNodeHeap array and manages their positions for efficient access
+// A MinHeap object is an indexed d-ary heap of MinHeapNodes, `pos` tells where each vertex currently sits
 struct MinHeap {
     int size;      
     int capacity;  
     int *pos;      
-    struct MinHeapNode **array; 
+    struct MinHeapNode *array; 
 };
 
-//Function to help create a new MinHeapNode for a given vertex and its distance
-struct MinHeapNode* newMinHeapNode(int v, int dist) {
-    struct MinHeapNode* minHeapNode = (struct MinHeapNode*) malloc(sizeof(struct MinHeapNode));
-    minHeapNode->v = v;
-    minHeapNode->dist = dist;
-    return minHeapNode;
-}
-
 //Function to help create a MinHeap and set up its capacity
 struct MinHeap* createMinHeap(int capacity) {
     struct MinHeap* minHeap = (struct MinHeap*) malloc(sizeof(struct MinHeap));
     minHeap->pos = (int *)malloc(capacity * sizeof(int));
     minHeap->size = 0;
     minHeap->capacity = capacity;
-    minHeap->array = (struct MinHeapNode**) malloc(capacity * sizeof(struct MinHeapNode*));
+    minHeap->array = (struct MinHeapNode*) malloc(capacity * sizeof(struct MinHeapNode));
     return minHeap;
 }
 
-//Function to swap two nodes in the min heap
-void swapMinHeapNode(struct MinHeapNode** a, struct MinHeapNode** b) {
-    struct MinHeapNode* t = *a;
-    *a = *b;
-    *b = t;
+//Function to free a MinHeap and everything it owns
+void freeMinHeap(struct MinHeap* minHeap) {
+    free(minHeap->pos);
+    free(minHeap->array);
+    free(minHeap);
 }
 
-// Function to maintain the min-heap property by "heapifying" a subtree with root at index `idx`
-void minHeapify(struct MinHeap* minHeap, int idx) {
-    int smallest = idx;
-    int left = 2 * idx + 1;
-    int right = 2 * idx + 2;
+// Function to maintain the min-heap property by moving the node at index `idx` down the tree
+// Instead of swapping at every level, the node is held aside and smaller children are moved up into the hole
+void siftDown(struct MinHeap* minHeap, int idx) {
+    struct MinHeapNode node = minHeap->array[idx];
 
-    // If the left child exists and is smaller than the current smallest make the smallest the left
-    if (left < minHeap->size && minHeap->array[left]->dist < minHeap->array[smallest]->dist)
-        smallest = left;
+    while (1) {
+        int first = HEAP_ARITY * idx + 1;
+        if (first >= minHeap->size)
+            break;
 
-    // If the right child exists and is smaller than the current smallest make the smallest the right
-    if (right < minHeap->size && minHeap->array[right]->dist < minHeap->array[smallest]->dist)
-        smallest = right;
-
-    // If the smallest element is not the root, swap with the smallest and heapify the affected subtree
-    if (smallest != idx) {
-        struct MinHeapNode* smallestNode = minHeap->array[smallest];
-        struct MinHeapNode* idxNode = minHeap->array[idx];
-
-        // Update the position of the nodes in the heap
-        minHeap->pos[smallestNode->v] = idx;
-        minHeap->pos[idxNode->v] = smallest;
+        // Find the smallest of the (up to) HEAP_ARITY children
+        int last = first + HEAP_ARITY;
+        if (last > minHeap->size)
+            last = minHeap->size;
+        int smallest = first;
+        for (int c = first + 1; c < last; c++) {
+            if (minHeap->array[c].dist < minHeap->array[smallest].dist)
+                smallest = c;
+        }
 
-        // Swap the two nodes
-        swapMinHeapNode(&minHeap->array[smallest], &minHeap->array[idx]);
+        // Stop once no child is smaller than the node being placed
+        if (minHeap->array[smallest].dist >= node.dist)
+            break;
 
-        // Recursively heapify the affected subtree
-        minHeapify(minHeap, smallest);
+        minHeap->array[idx] = minHeap->array[smallest];
+        minHeap->pos[minHeap->array[idx].v] = idx;
+        idx = smallest;
     }
+
+    minHeap->array[idx] = node;
+    minHeap->pos[node.v] = idx;
 }
 
 // Function to check if the heap is empty
@@ -86,47 +107,42 @@ int isEmpty(struct MinHeap* minHeap) {
     return minHeap->size == 0;
 }
 
-//Function to extract the root from the min heap
-struct MinHeapNode* extractMin(struct MinHeap* minHeap) {
-    if (isEmpty(minHeap))
-        return NULL;
-
+//Function to extract the root from the min heap and return its vertex
+int extractMin(struct MinHeap* minHeap) {
     // The root of the heap is the minimum element
-    struct MinHeapNode* root = minHeap->array[0];
+    int root = minHeap->array[0].v;
 
-    // Replace the root with the last element in the heap
-    struct MinHeapNode* lastNode = minHeap->array[minHeap->size - 1];
-    minHeap->array[0] = lastNode;
+    // Replace the root with the last element in the heap and shrink the heap
+    --minHeap->size;
+    minHeap->array[0] = minHeap->array[minHeap->size];
 
-    // Update the position of the last node
-    minHeap->pos[root->v] = minHeap->size-1;
-    minHeap->pos[lastNode->v] = 0;
+    // The extracted vertex keeps a position past the end so isInMinHeap reports it as gone
+    minHeap->pos[root] = minHeap->size;
 
-    // Reduce the heap size and heapify from the root to maintain the min-heap property
-    --minHeap->size;
-    minHeapify(minHeap, 0);
+    // Heapify from the root to maintain the min-heap property
+    if (minHeap->size > 0)
+        siftDown(minHeap, 0);
 
     return root;
 }
 
 // Function to decrease the distance value of a given vertex `v` in the heap
 void decreaseKey(struct MinHeap* minHeap, int v, int dist) {
-    
     int i = minHeap->pos[v];
 
-    
-    minHeap->array[i]->dist = dist;
-
-    // Traverse up the tree and fix the heap property if necessary
-    while (i && minHeap->array[i]->dist < minHeap->array[(i - 1) / 2]->dist) {
-
-        minHeap->pos[minHeap->array[i]->v] = (i-1)/2;
-        minHeap->pos[minHeap->array[(i-1)/2]->v] = i;
-        swapMinHeapNode(&minHeap->array[i], &minHeap->array[(i - 1) / 2]);
+    // Traverse up the tree, moving larger parents down into the hole until the new distance fits
+    while (i && dist < minHeap->array[(i - 1) / HEAP_ARITY].dist) {
+        int parent = (i - 1) / HEAP_ARITY;
+        minHeap->array[i] = minHeap->array[parent];
+        minHeap->pos[minHeap->array[i].v] = i;
 
         // Move to the parent index
-        i = (i - 1) / 2;
+        i = parent;
     }
+
+    minHeap->array[i].dist = dist;
+    minHeap->array[i].v = v;
+    minHeap->pos[v] = i;
 }
 
 // Function to check if a given vertex `v` is in the min heap or not
@@ -134,8 +150,69 @@ int isInMinHeap(struct MinHeap *minHeap, int v) {
    return minHeap->pos[v] < minHeap->size;
 }
 
+// Function to read `num_edges` undirected edges and build the compressed graph in two passes
+// The first pass counts the degree of every vertex, the second drops each edge into its slot
+struct Graph* readGraph(int num_vertices, int num_edges) {
+    int *from = (int *)malloc(num_edges * sizeof(int));
+    struct Edge *list = (struct Edge *)malloc(num_edges * sizeof(struct Edge));
+    struct Graph *graph = (struct Graph *)malloc(sizeof(struct Graph));
+    graph->num_vertices = num_vertices;
+    graph->offsets = (int *)calloc(num_vertices + 1, sizeof(int));
+    graph->edges = (struct Edge *)malloc(2 * (size_t)num_edges * sizeof(struct Edge));
+
+    // Read edges from the file using input redirection and count the degree of each endpoint
+    for (int i = 0; i < num_edges; i++) {
+        int u, v, length;
+        if (scanf("%d %d %d", &u, &v, &length) != 3) {
+            fprintf(stderr, "Error reading edge.\n");
+            exit(1);
+        }
+        if (u < 0 || u >= num_vertices || v < 0 || v >= num_vertices) {
+            fprintf(stderr, "Edge %d %d is out of range.\n", u, v);
+            exit(1);
+        }
+        from[i] = u;
+        list[i].to = v;
+        list[i].length = length;
+        graph->offsets[u + 1]++;
+        graph->offsets[v + 1]++; // For an undirected graph, the reverse edge needs a slot as well
+    }
+
+    // Turn the degree counts into starting offsets
+    for (int u = 0; u < num_vertices; u++) {
+        graph->offsets[u + 1] += graph->offsets[u];
+    }
+
+    // Fill each vertex's slots in order, using a cursor that starts at its offset
+    int *fill = (int *)malloc(num_vertices * sizeof(int));
+    for (int u = 0; u < num_vertices; u++) {
+        fill[u] = graph->offsets[u];
+    }
+    for (int i = 0; i < num_edges; i++) {
+        int u = from[i];
+        int v = list[i].to;
+        graph->edges[fill[u]].to = v;
+        graph->edges[fill[u]++].length = list[i].length;
+        graph->edges[fill[v]].to = u;
+        graph->edges[fill[v]++].length = list[i].length;
+    }
+
+    free(fill);
+    free(from);
+    free(list);
+    return graph;
+}
+
+// Function to free a graph built by readGraph
+void freeGraph(struct Graph *graph) {
+    free(graph->offsets);
+    free(graph->edges);
+    free(graph);
+}
+
 // Prim's algorithm to find the Minimum Spanning Tree (MST) using a MinHeap
-int primMST(struct Edge** graph, int* num_edges, int num_vertices) {
+int primMST(struct Graph *graph) {
+    int num_vertices = graph->num_vertices;
     int* parent = (int*)malloc(num_vertices * sizeof(int)); // Stores the parent
 
     int* key = (int*)malloc(num_vertices * sizeof(int)); // Stores the minimum edge weight to add the vertex to the MST.
@@ -146,7 +223,8 @@ int primMST(struct Edge** graph, int* num_edges, int num_vertices) {
     for (int v = 0; v < num_vertices; ++v) {
         parent[v] = -1; // No parent an infinite length intailly
         key[v] = INF;    
-        minHeap->array[v] = newMinHeapNode(v, key[v]);
+        minHeap->array[v].dist = key[v];
+        minHeap->array[v].v = v;
         minHeap->pos[v] = v; // Position of each vertex in the heap
     }
 
@@ -159,13 +237,12 @@ int primMST(struct Edge** graph, int* num_edges, int num_vertices) {
     // Iterate while the heap is not empty
     while (!isEmpty(minHeap)) {
         // Extract the vertex with the minimum key value
-        struct MinHeapNode* minHeapNode = extractMin(minHeap);
-        int u = minHeapNode->v; // The vertex we just added to the MST
+        int u = extractMin(minHeap); // The vertex we just added to the MST
 
-        // Update key values for all adjacent vertices
-        for (int i = 0; i < num_edges[u]; i++) {
-            int v = graph[u][i].to;
-            int weight = graph[u][i].length;
+        // Update key values for all adjacent vertices, which sit next to each other in the edge array
+        for (int i = graph->offsets[u]; i < graph->offsets[u + 1]; i++) {
+            int v = graph->edges[i].to;
+            int weight = graph->edges[i].length;
 
             // If `v` is in the heap and the edge `u-v` is the smallest we've seen so far
             if (isInMinHeap(minHeap, v) && weight < key[v]) {
@@ -185,15 +262,735 @@ int primMST(struct Edge** graph, int* num_edges, int num_vertices) {
     // Free Memory
     free(parent);
     free(key);
-    free(minHeap->pos);
-    free(minHeap->array);
-    free(minHeap);
+    freeMinHeap(minHeap);
+
+    return total_weight;
+
+}
+
+#define DENSE_DENSITY 16 // Pick dense Prim automatically once 16 * E reaches V * V
+
+// Function to find the smallest value in `key[0..n)` and return its index, or -1 if everything is INF
+// With AVX2 or SSE4.1 the minimum is found 8 or 4 keys at a time, then a second pass finds where it sits
+int findMinKey(const int *key, int n) {
+    int i = 0;
+    int best = INF;
+
+#if defined(__AVX2__)
+    __m256i vmin = _mm256_set1_epi32(INF);
+    for (; i + 8 <= n; i += 8) {
+        vmin = _mm256_min_epi32(vmin, _mm256_loadu_si256((const __m256i *)(key + i)));
+    }
+    __m128i half = _mm_min_epi32(_mm256_castsi256_si128(vmin), _mm256_extracti128_si256(vmin, 1));
+    half = _mm_min_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(1, 0, 3, 2)));
+    half = _mm_min_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(2, 3, 0, 1)));
+    best = _mm_cvtsi128_si32(half);
+#elif defined(__SSE4_1__)
+    __m128i vmin = _mm_set1_epi32(INF);
+    for (; i + 4 <= n; i += 4) {
+        vmin = _mm_min_epi32(vmin, _mm_loadu_si128((const __m128i *)(key + i)));
+    }
+    vmin = _mm_min_epi32(vmin, _mm_shuffle_epi32(vmin, _MM_SHUFFLE(1, 0, 3, 2)));
+    vmin = _mm_min_epi32(vmin, _mm_shuffle_epi32(vmin, _MM_SHUFFLE(2, 3, 0, 1)));
+    best = _mm_cvtsi128_si32(vmin);
+#endif
+
+    // Whatever did not fill a whole vector is checked one key at a time
+    for (; i < n; i++) {
+        if (key[i] < best)
+            best = key[i];
+    }
+    if (best == INF)
+        return -1;
+
+    // Find the first index that holds the minimum
+    i = 0;
+#if defined(__AVX2__)
+    __m256i target = _mm256_set1_epi32(best);
+    for (; i + 8 <= n; i += 8) {
+        int mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i *)(key + i)), target)));
+        if (mask)
+            return i + __builtin_ctz(mask);
+    }
+#elif defined(__SSE4_1__)
+    __m128i target = _mm_set1_epi32(best);
+    for (; i + 4 <= n; i += 4) {
+        int mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *)(key + i)), target)));
+        if (mask)
+            return i + __builtin_ctz(mask);
+    }
+#endif
+    for (; i < n; i++) {
+        if (key[i] == best)
+            return i;
+    }
+    return -1;
+}
+
+// Prim's algorithm for dense graphs, which drops the heap and scans a flat key array for the next vertex
+// That is O(V^2 + E) overall, which beats the heap once nearly every relaxation would call decreaseKey
+int densePrimMST(struct Graph *graph) {
+    int num_vertices = graph->num_vertices;
+
+    // `key` holds the MST weights, `open` holds the same keys but INF for vertices already in the tree
+    // so the min-scan can run over the whole array without checking a visited flag
+    int* key = (int*)malloc(num_vertices * sizeof(int));
+    int* open = (int*)malloc(num_vertices * sizeof(int));
+    char* inMST = (char*)calloc(num_vertices, sizeof(char));
+    for (int v = 0; v < num_vertices; ++v) {
+        key[v] = INF;
+        open[v] = INF;
+    }
+
+    // Start with the first vertex (index 0) and set its key value to 0
+    key[0] = 0;
+    open[0] = 0;
+
+    int u;
+    while ((u = findMinKey(open, num_vertices)) != -1) {
+        inMST[u] = 1;
+        open[u] = INF;
+
+        // Update key values for all adjacent vertices that are not in the tree yet
+        for (int i = graph->offsets[u]; i < graph->offsets[u + 1]; i++) {
+            int v = graph->edges[i].to;
+            int weight = graph->edges[i].length;
+            if (!inMST[v] && weight < key[v]) {
+                key[v] = weight;
+                open[v] = weight;
+            }
+        }
+    }
+
+    // Calculate the total weight of the MST
+    int total_weight = 0;
+    for (int i = 1; i < num_vertices; ++i) {
+        total_weight += key[i];
+    }
+
+    // Free Memory
+    free(inMST);
+    free(open);
+    free(key);
+
+    return total_weight;
+}
+
+// Function to list every undirected edge of the graph once, skipping self loops
+// Each edge sits in both endpoints' lists, so only the copy stored under the smaller endpoint is kept
+struct WeightedEdge* collectEdges(struct Graph *graph, int *count) {
+    int n = 0;
+    struct WeightedEdge *list = (struct WeightedEdge *)malloc((graph->offsets[graph->num_vertices] / 2 + 1) * sizeof(struct WeightedEdge));
+    for (int u = 0; u < graph->num_vertices; u++) {
+        for (int i = graph->offsets[u]; i < graph->offsets[u + 1]; i++) {
+            if (graph->edges[i].to > u) {
+                list[n].u = u;
+                list[n].v = graph->edges[i].to;
+                list[n].length = graph->edges[i].length;
+                n++;
+            }
+        }
+    }
+    *count = n;
+    return list;
+}
+
+// Function to find the root of `x` in a union-find forest that several threads may update at once
+// Path halving only ever moves a pointer up to an ancestor, so a failed compare-and-swap is harmless
+int findRoot(_Atomic int *parent, int x) {
+    while (1) {
+        int p = atomic_load_explicit(&parent[x], memory_order_relaxed);
+        if (p == x)
+            return x;
+        int gp = atomic_load_explicit(&parent[p], memory_order_relaxed);
+        if (gp != p)
+            atomic_compare_exchange_weak(&parent[x], &p, gp);
+        x = gp;
+    }
+}
+
+// Function to join the sets of `u` and `v`, returns 1 if this call did the join and 0 if they were already joined
+// The larger root is always hung under the smaller one, which keeps concurrent links from forming a cycle
+int unionRoots(_Atomic int *parent, int u, int v) {
+    while (1) {
+        int ru = findRoot(parent, u);
+        int rv = findRoot(parent, v);
+        if (ru == rv)
+            return 0;
+        if (ru < rv) {
+            int t = ru;
+            ru = rv;
+            rv = t;
+        }
+        int expected = ru;
+        if (atomic_compare_exchange_strong(&parent[ru], &expected, rv))
+            return 1;
+    }
+}
+
+#define NO_EDGE ULLONG_MAX // Marks a component that has not found an outgoing edge yet
+
+// State shared by the Boruvka worker threads, each thread works on its own slice [begin, end)
+struct BoruvkaTask {
+    struct WeightedEdge *edges;
+    _Atomic int *parent;
+    _Atomic unsigned long long *best;
+    int begin;
+    int end;
+    long long weight; // Weight of the edges this thread added during the merge step
+    int merged;       // Number of joins this thread did during the merge step
+};
+
+// Function to pack an edge into one word that orders by length first and edge index second
+// Breaking ties by index makes every component agree on the same minimum edge, so no cycles appear
+unsigned long long packEdge(int length, int index) {
+    return ((unsigned long long)((unsigned int)length ^ 0x80000000u) << 32) | (unsigned int)index;
+}
+
+// Function to lower best[r] to `key` if it is smaller, retrying when another thread gets there first
+void atomicMin(_Atomic unsigned long long *slot, unsigned long long key) {
+    unsigned long long current = atomic_load_explicit(slot, memory_order_relaxed);
+    while (key < current && !atomic_compare_exchange_weak(slot, &current, key))
+        ;
+}
+
+// Worker for the first Boruvka step, which offers each edge in the slice to both components it touches
+void* boruvkaFindMin(void *arg) {
+    struct BoruvkaTask *task = (struct BoruvkaTask *)arg;
+    for (int i = task->begin; i < task->end; i++) {
+        int ru = findRoot(task->parent, task->edges[i].u);
+        int rv = findRoot(task->parent, task->edges[i].v);
+        if (ru == rv)
+            continue;
+        unsigned long long key = packEdge(task->edges[i].length, i);
+        atomicMin(&task->best[ru], key);
+        atomicMin(&task->best[rv], key);
+    }
+    return NULL;
+}
+
+// Worker for the second Boruvka step, which joins each component in the slice along its cheapest edge
+void* boruvkaMerge(void *arg) {
+    struct BoruvkaTask *task = (struct BoruvkaTask *)arg;
+    task->weight = 0;
+    task->merged = 0;
+    for (int r = task->begin; r < task->end; r++) {
+        unsigned long long key = atomic_load_explicit(&task->best[r], memory_order_relaxed);
+        if (key == NO_EDGE)
+            continue;
+        atomic_store_explicit(&task->best[r], NO_EDGE, memory_order_relaxed);
+
+        // Both components may pick the same edge, only the thread that actually joins them counts it
+        struct WeightedEdge *e = &task->edges[(unsigned int)key];
+        if (unionRoots(task->parent, e->u, e->v)) {
+            task->weight += e->length;
+            task->merged++;
+        }
+    }
+    return NULL;
+}
+
+// Function to run `work` on `num_threads` threads, splitting [0, n) into equal slices
+void runSlices(void* (*work)(void *), struct BoruvkaTask *tasks, int num_threads, int n) {
+    pthread_t *threads = (pthread_t *)malloc(num_threads * sizeof(pthread_t));
+    for (int t = 0; t < num_threads; t++) {
+        tasks[t].begin = (int)((long long)n * t / num_threads);
+        tasks[t].end = (int)((long long)n * (t + 1) / num_threads);
+        pthread_create(&threads[t], NULL, work, &tasks[t]);
+    }
+    for (int t = 0; t < num_threads; t++) {
+        pthread_join(threads[t], NULL);
+    }
+    free(threads);
+}
+
+// Parallel Boruvka's algorithm to find the weight of the Minimum Spanning Tree (MST)
+// Every round, all threads find each component's cheapest outgoing edge, then all components merge along them
+int boruvkaMST(struct Graph *graph, int num_threads) {
+    int num_vertices = graph->num_vertices;
+    int num_edges;
+    struct WeightedEdge *edges = collectEdges(graph, &num_edges);
+
+    _Atomic int *parent = (_Atomic int *)malloc(num_vertices * sizeof(_Atomic int));
+    _Atomic unsigned long long *best = (_Atomic unsigned long long *)malloc(num_vertices * sizeof(_Atomic unsigned long long));
+    for (int v = 0; v < num_vertices; v++) {
+        atomic_init(&parent[v], v);
+        atomic_init(&best[v], NO_EDGE);
+    }
+
+    struct BoruvkaTask *tasks = (struct BoruvkaTask *)malloc(num_threads * sizeof(struct BoruvkaTask));
+    for (int t = 0; t < num_threads; t++) {
+        tasks[t].edges = edges;
+        tasks[t].parent = parent;
+        tasks[t].best = best;
+    }
+
+    // Each round at least halves the number of components, so this runs O(log V) times
+    long long total_weight = 0;
+    int merged = 1;
+    while (merged) {
+        runSlices(boruvkaFindMin, tasks, num_threads, num_edges);
+        runSlices(boruvkaMerge, tasks, num_threads, num_vertices);
+
+        merged = 0;
+        for (int t = 0; t < num_threads; t++) {
+            total_weight += tasks[t].weight;
+            merged += tasks[t].merged;
+        }
+    }
+
+    // Free Memory
+    free(tasks);
+    free(best);
+    free(parent);
+    free(edges);
+
+    return (int)total_weight;
+}
+
+#define KRUSKAL_BASE_CASE 65536 // Below this many edges filter-Kruskal just sorts and scans
+
+// Function to compare two edges by length for qsort
+int compareEdges(const void *a, const void *b) {
+    int la = ((const struct WeightedEdge *)a)->length;
+    int lb = ((const struct WeightedEdge *)b)->length;
+    return (la > lb) - (la < lb);
+}
+
+// A SortTask object describes one chunk to sort or one pair of sorted runs to merge
+struct SortTask {
+    struct WeightedEdge *src;
+    struct WeightedEdge *dst;
+    int begin;
+    int middle;
+    int end;
+};
+
+// Worker that sorts one chunk in place
+void* sortChunk(void *arg) {
+    struct SortTask *task = (struct SortTask *)arg;
+    qsort(task->src + task->begin, task->end - task->begin, sizeof(struct WeightedEdge), compareEdges);
+    return NULL;
+}
+
+// Worker that merges the sorted runs [begin, middle) and [middle, end) of src into dst
+void* mergeChunks(void *arg) {
+    struct SortTask *task = (struct SortTask *)arg;
+    int i = task->begin, j = task->middle, k = task->begin;
+    while (i < task->middle && j < task->end) {
+        if (task->src[j].length < task->src[i].length)
+            task->dst[k++] = task->src[j++];
+        else
+            task->dst[k++] = task->src[i++];
+    }
+    while (i < task->middle)
+        task->dst[k++] = task->src[i++];
+    while (j < task->end)
+        task->dst[k++] = task->src[j++];
+    return NULL;
+}
+
+// Function to sort edges by length with several threads
+// Each thread sorts one chunk, then neighbouring runs are merged pairwise until one run is left
+void parallelSortEdges(struct WeightedEdge *edges, int n, int num_threads) {
+    if (num_threads <= 1 || n < 2 * num_threads) {
+        qsort(edges, n, sizeof(struct WeightedEdge), compareEdges);
+        return;
+    }
+
+    pthread_t *threads = (pthread_t *)malloc(num_threads * sizeof(pthread_t));
+    struct SortTask *tasks = (struct SortTask *)malloc(num_threads * sizeof(struct SortTask));
+    int *bounds = (int *)malloc((num_threads + 1) * sizeof(int));
+    for (int t = 0; t <= num_threads; t++) {
+        bounds[t] = (int)((long long)n * t / num_threads);
+    }
+
+    // Sort every chunk on its own thread
+    for (int t = 0; t < num_threads; t++) {
+        tasks[t].src = edges;
+        tasks[t].begin = bounds[t];
+        tasks[t].end = bounds[t + 1];
+        pthread_create(&threads[t], NULL, sortChunk, &tasks[t]);
+    }
+    for (int t = 0; t < num_threads; t++) {
+        pthread_join(threads[t], NULL);
+    }
+
+    // Merge runs that are `width` chunks wide into runs twice as wide, swapping buffers each pass
+    struct WeightedEdge *buffer = (struct WeightedEdge *)malloc(n * sizeof(struct WeightedEdge));
+    struct WeightedEdge *src = edges, *dst = buffer;
+    for (int width = 1; width < num_threads; width *= 2) {
+        int pairs = 0;
+        for (int t = 0; t < num_threads; t += 2 * width) {
+            int middle = t + width < num_threads ? t + width : num_threads;
+            int end = t + 2 * width < num_threads ? t + 2 * width : num_threads;
+            tasks[pairs].src = src;
+            tasks[pairs].dst = dst;
+            tasks[pairs].begin = bounds[t];
+            tasks[pairs].middle = bounds[middle];
+            tasks[pairs].end = bounds[end];
+            pthread_create(&threads[pairs], NULL, mergeChunks, &tasks[pairs]);
+            pairs++;
+        }
+        for (int p = 0; p < pairs; p++) {
+            pthread_join(threads[p], NULL);
+        }
+        struct WeightedEdge *t = src;
+        src = dst;
+        dst = t;
+    }
+    if (src != edges)
+        memcpy(edges, src, n * sizeof(struct WeightedEdge));
+
+    free(buffer);
+    free(bounds);
+    free(tasks);
+    free(threads);
+}
+
+// Function to move every edge shorter than (or, if `inclusive`, equal to) `pivot` to the front, returns how many moved
+int partitionEdges(struct WeightedEdge *edges, int n, int pivot, int inclusive) {
+    int light = 0;
+    for (int i = 0; i < n; i++) {
+        if (edges[i].length < pivot || (inclusive && edges[i].length == pivot)) {
+            struct WeightedEdge t = edges[i];
+            edges[i] = edges[light];
+            edges[light++] = t;
+        }
+    }
+    return light;
+}
+
+// Filter-Kruskal: solve the light half first, then throw away heavy edges that already close a cycle
+// Most heavy edges in a dense graph get filtered out this way and never need to be sorted
+long long filterKruskal(struct WeightedEdge *edges, int n, _Atomic int *parent, int num_threads) {
+    long long total_weight = 0;
 
+    if (n > KRUSKAL_BASE_CASE) {
+        // Median of three lengths as the pivot
+        int a = edges[0].length, b = edges[n / 2].length, c = edges[n - 1].length;
+        int pivot = a < b ? (b < c ? b : (a < c ? c : a)) : (a < c ? a : (b < c ? c : b));
+
+        int light = partitionEdges(edges, n, pivot, 0);
+        if (light == 0)
+            light = partitionEdges(edges, n, pivot, 1);
+
+        if (light < n) {
+            total_weight += filterKruskal(edges, light, parent, num_threads);
+
+            // Keep only the heavy edges whose endpoints are still in different trees
+            struct WeightedEdge *heavy = edges + light;
+            int kept = 0;
+            for (int i = 0; i < n - light; i++) {
+                if (findRoot(parent, heavy[i].u) != findRoot(parent, heavy[i].v))
+                    heavy[kept++] = heavy[i];
+            }
+
+            total_weight += filterKruskal(heavy, kept, parent, num_threads);
+            return total_weight;
+        }
+    }
+
+    // Base case: sort what is left and add every edge that joins two different trees
+    parallelSortEdges(edges, n, num_threads);
+    for (int i = 0; i < n; i++) {
+        if (unionRoots(parent, edges[i].u, edges[i].v))
+            total_weight += edges[i].length;
+    }
     return total_weight;
+}
+
+// Filter-Kruskal's algorithm to find the weight of the Minimum Spanning Tree (MST)
+int kruskalMST(struct Graph *graph, int num_threads) {
+    int num_vertices = graph->num_vertices;
+    int num_edges;
+    struct WeightedEdge *edges = collectEdges(graph, &num_edges);
+
+    _Atomic int *parent = (_Atomic int *)malloc(num_vertices * sizeof(_Atomic int));
+    for (int v = 0; v < num_vertices; v++) {
+        atomic_init(&parent[v], v);
+    }
+
+    long long total_weight = filterKruskal(edges, num_edges, parent, num_threads);
+
+    // Free Memory
+    free(parent);
+    free(edges);
+
+    return (int)total_weight;
+}
+
+// A LinkCutTree object keeps the current spanning forest as a dynamic tree so path maximums cost O(log V)
+// Nodes 0..V-1 are the vertices, the rest stand for tree edges so each edge can carry its own length
+struct LinkCutTree {
+    int (*child)[2]; // Left and right child in the splay tree, -1 if missing
+    int *parent;     // Splay parent, or the path-parent pointer for the root of a splay tree
+    char *flip;      // Lazy flag: this subtree's left and right still need swapping
+    int *weight;     // Length of an edge node, INT_MIN for vertex nodes so they never win a maximum
+    int *maxNode;    // The heaviest node in this splay subtree
+    int *edgeU;      // Endpoints of an edge node
+    int *edgeV;
+    int *freeList;   // Edge nodes that are not in the forest right now
+    int freeCount;
+    int *stack;      // Scratch space for splay to push flips down from the top
+};
+
+//Function to create a LinkCutTree with every vertex in its own tree
+struct LinkCutTree* createLinkCutTree(int num_vertices) {
+    int num_nodes = 2 * num_vertices; // A forest never holds more than V - 1 edges
+    struct LinkCutTree *lct = (struct LinkCutTree *)malloc(sizeof(struct LinkCutTree));
+    lct->child = (int (*)[2])malloc(num_nodes * sizeof(*lct->child));
+    lct->parent = (int *)malloc(num_nodes * sizeof(int));
+    lct->flip = (char *)calloc(num_nodes, sizeof(char));
+    lct->weight = (int *)malloc(num_nodes * sizeof(int));
+    lct->maxNode = (int *)malloc(num_nodes * sizeof(int));
+    lct->edgeU = (int *)malloc(num_nodes * sizeof(int));
+    lct->edgeV = (int *)malloc(num_nodes * sizeof(int));
+    lct->freeList = (int *)malloc(num_vertices * sizeof(int));
+    lct->freeCount = 0;
+    lct->stack = (int *)malloc(num_nodes * sizeof(int));
+    for (int x = 0; x < num_nodes; x++) {
+        lct->child[x][0] = lct->child[x][1] = -1;
+        lct->parent[x] = -1;
+        lct->weight[x] = INT_MIN;
+        lct->maxNode[x] = x;
+    }
+    for (int x = num_nodes - 1; x >= num_vertices; x--) {
+        lct->freeList[lct->freeCount++] = x;
+    }
+    return lct;
+}
+
+//Function to free a LinkCutTree and everything it owns
+void freeLinkCutTree(struct LinkCutTree *lct) {
+    free(lct->child);
+    free(lct->parent);
+    free(lct->flip);
+    free(lct->weight);
+    free(lct->maxNode);
+    free(lct->edgeU);
+    free(lct->edgeV);
+    free(lct->freeList);
+    free(lct->stack);
+    free(lct);
+}
+
+// Function to check if `x` is the root of its splay tree
+int isSplayRoot(struct LinkCutTree *lct, int x) {
+    int p = lct->parent[x];
+    return p == -1 || (lct->child[p][0] != x && lct->child[p][1] != x);
+}
+
+// Function to recompute the heaviest node under `x` from its children
+void pushUp(struct LinkCutTree *lct, int x) {
+    lct->maxNode[x] = x;
+    for (int d = 0; d < 2; d++) {
+        int c = lct->child[x][d];
+        if (c != -1 && lct->weight[lct->maxNode[c]] > lct->weight[lct->maxNode[x]])
+            lct->maxNode[x] = lct->maxNode[c];
+    }
+}
+
+// Function to apply a pending reversal at `x` and hand it down to its children
+void pushDown(struct LinkCutTree *lct, int x) {
+    if (lct->flip[x]) {
+        int t = lct->child[x][0];
+        lct->child[x][0] = lct->child[x][1];
+        lct->child[x][1] = t;
+        for (int d = 0; d < 2; d++) {
+            if (lct->child[x][d] != -1)
+                lct->flip[lct->child[x][d]] ^= 1;
+        }
+        lct->flip[x] = 0;
+    }
+}
+
+// Function to rotate `x` above its splay parent
+void rotate(struct LinkCutTree *lct, int x) {
+    int y = lct->parent[x];
+    int z = lct->parent[y];
+    int dx = lct->child[y][1] == x;
+
+    if (!isSplayRoot(lct, y))
+        lct->child[z][lct->child[z][1] == y] = x;
+    lct->parent[x] = z;
+
+    lct->child[y][dx] = lct->child[x][!dx];
+    if (lct->child[y][dx] != -1)
+        lct->parent[lct->child[y][dx]] = y;
+
+    lct->child[x][!dx] = y;
+    lct->parent[y] = x;
+
+    pushUp(lct, y);
+    pushUp(lct, x);
+}
+
+// Function to splay `x` to the root of its splay tree, pushing pending reversals down on the way
+void splay(struct LinkCutTree *lct, int x) {
+    // Pending flips above `x` have to be applied top-down before any rotation, so walk up then apply in reverse
+    int depth = 0;
+    for (int y = x; ; y = lct->parent[y]) {
+        lct->stack[depth++] = y;
+        if (isSplayRoot(lct, y))
+            break;
+    }
+    while (depth > 0) {
+        pushDown(lct, lct->stack[--depth]);
+    }
+
+    while (!isSplayRoot(lct, x)) {
+        int y = lct->parent[x];
+        if (!isSplayRoot(lct, y)) {
+            int z = lct->parent[y];
+            rotate(lct, (lct->child[y][0] == x) == (lct->child[z][0] == y) ? y : x);
+        }
+        rotate(lct, x);
+    }
+}
+
+// Function to make the path from the root of the represented tree down to `x` one splay tree
+void exposePath(struct LinkCutTree *lct, int x) {
+    for (int last = -1; x != -1; last = x, x = lct->parent[x]) {
+        splay(lct, x);
+        lct->child[x][1] = last;
+        pushUp(lct, x);
+    }
+}
+
+// Function to reroot the represented tree at `x`
+void makeRoot(struct LinkCutTree *lct, int x) {
+    exposePath(lct, x);
+    splay(lct, x);
+    lct->flip[x] ^= 1;
+}
+
+// Function to find the root of the represented tree holding `x`
+int treeRoot(struct LinkCutTree *lct, int x) {
+    exposePath(lct, x);
+    splay(lct, x);
+    while (pushDown(lct, x), lct->child[x][0] != -1) {
+        x = lct->child[x][0];
+    }
+    splay(lct, x);
+    return x;
+}
+
+// Function to join the trees of `x` and `y` with an edge between them
+void linkTrees(struct LinkCutTree *lct, int x, int y) {
+    makeRoot(lct, x);
+    lct->parent[x] = y;
+}
 
+// Function to remove the edge between the neighbours `x` and `y`
+void cutEdge(struct LinkCutTree *lct, int x, int y) {
+    makeRoot(lct, x);
+    exposePath(lct, y);
+    splay(lct, y);
+    lct->child[y][0] = -1;
+    lct->parent[x] = -1;
+    pushUp(lct, y);
+}
+
+// Function to add the edge `u-v` to the spanning forest, returns how much the forest weight changed
+// If `u` and `v` are already connected, the new edge replaces the heaviest edge on their path when it is lighter
+long long insertEdge(struct LinkCutTree *lct, int u, int v, int length) {
+    if (u == v)
+        return 0;
+
+    long long change = 0;
+    if (treeRoot(lct, u) == treeRoot(lct, v)) {
+        // Find the heaviest edge on the tree path between `u` and `v`
+        makeRoot(lct, u);
+        exposePath(lct, v);
+        splay(lct, v);
+        int heaviest = lct->maxNode[v];
+        if (lct->weight[heaviest] <= length)
+            return 0; // The new edge would close a cycle without making the tree any lighter
+
+        // Take the heaviest edge out of the forest and give its node back to the free list
+        cutEdge(lct, lct->edgeU[heaviest], heaviest);
+        cutEdge(lct, heaviest, lct->edgeV[heaviest]);
+        change -= lct->weight[heaviest];
+        lct->weight[heaviest] = INT_MIN;
+        lct->maxNode[heaviest] = heaviest;
+        lct->freeList[lct->freeCount++] = heaviest;
+    }
+
+    // Hang the new edge node between `u` and `v`
+    int e = lct->freeList[--lct->freeCount];
+    lct->weight[e] = length;
+    lct->maxNode[e] = e;
+    lct->edgeU[e] = u;
+    lct->edgeV[e] = v;
+    linkTrees(lct, u, e);
+    linkTrees(lct, e, v);
+    return change + length;
+}
+
+// Function to build the MST edge by edge and then keep it up to date while new edges stream in on stdin
+// Each batch is a count `k` followed by `k` lines of `u v length`, and the new total weight is printed after each one
+void incrementalMST(struct Graph *graph) {
+    int num_vertices = graph->num_vertices;
+    struct LinkCutTree *lct = createLinkCutTree(num_vertices);
+
+    // Every edge of the starting graph goes through the same insertion as the streamed ones
+    long long total_weight = 0;
+    for (int u = 0; u < num_vertices; u++) {
+        for (int i = graph->offsets[u]; i < graph->offsets[u + 1]; i++) {
+            if (graph->edges[i].to > u)
+                total_weight += insertEdge(lct, u, graph->edges[i].to, graph->edges[i].length);
+        }
+    }
+    printf("%lld\n", total_weight);
+    fflush(stdout);
+
+    int batch;
+    while (scanf("%d", &batch) == 1) {
+        for (int i = 0; i < batch; i++) {
+            int u, v, length;
+            if (scanf("%d %d %d", &u, &v, &length) != 3) {
+                fprintf(stderr, "Error reading edge.\n");
+                exit(1);
+            }
+            if (u < 0 || u >= num_vertices || v < 0 || v >= num_vertices) {
+                fprintf(stderr, "Edge %d %d is out of range.\n", u, v);
+                exit(1);
+            }
+            total_weight += insertEdge(lct, u, v, length);
+        }
+        printf("%lld\n", total_weight);
+        fflush(stdout);
+    }
+
+    freeLinkCutTree(lct);
 }
 
 int main(int argc, char *argv[]) { 
+    const char *engine = NULL; // Chosen from the graph density unless set on the command line
+    int num_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int incremental = 0;
+
+    // Pick the MST engine and thread count from the command line, the graph still comes from input redirection
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--engine") == 0 && i + 1 < argc) {
+            engine = argv[++i];
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            num_threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--incremental") == 0) {
+            incremental = 1;
+        } else {
+            fprintf(stderr, "Usage: %s [--engine prim|dense|boruvka|kruskal] [--threads n] [--incremental] < inputfile\n", argv[0]);
+            return 1;
+        }
+    }
+    if (engine && strcmp(engine, "prim") != 0 && strcmp(engine, "dense") != 0 && strcmp(engine, "boruvka") != 0 && strcmp(engine, "kruskal") != 0) {
+        fprintf(stderr, "Unknown engine %s, expected prim, dense, boruvka or kruskal.\n", engine);
+        return 1;
+    }
+    if (num_threads < 1)
+        num_threads = 1;
+
     int num_vertices, num_edges;
 
     // Read number of vertices and edges from input redirection
@@ -202,45 +999,37 @@ int main(int argc, char *argv[]) {
         return 1;
     }
 
-    // Allocate memory for the graph of edges
-    struct Edge** graph = (struct Edge**)malloc(num_vertices * sizeof(struct Edge*));
-    int* num_edges_per_vertex = (int*)malloc(num_vertices * sizeof(int));
-    for (int i = 0; i < num_vertices; i++) {
-        graph[i] = (struct Edge*)malloc(num_edges * sizeof(struct Edge)); // Allocate space for edges
-        num_edges_per_vertex[i] = 0; // Initialize count of edges per vertex
-    }
+    // Without an engine on the command line, near-complete graphs go to dense Prim and the rest to the heap
+    if (!engine)
+        engine = (long long)num_edges * DENSE_DENSITY >= (long long)num_vertices * num_vertices ? "dense" : "prim";
 
-    // Read edges from the file using input redirection
-    for (int i = 0; i < num_edges; i++) {
-        int u, v, length;
-        if (scanf("%d %d %d", &u, &v, &length) != 3) {
-            fprintf(stderr, "Error reading edge.\n");
-            return 1;
-        }
-        // Insert edge into the graph
-        graph[u][num_edges_per_vertex[u]].to = v;
-        graph[u][num_edges_per_vertex[u]].length = length;
-        num_edges_per_vertex[u]++;
-        
-        // For an undirected graph, insert the reverse edge as well
-        graph[v][num_edges_per_vertex[v]].to = u;
-        graph[v][num_edges_per_vertex[v]].length = length;
-        num_edges_per_vertex[v]++;
+    // Read the edges into a compressed graph, which takes O(V + E) memory
+    struct Graph* graph = readGraph(num_vertices, num_edges);
+
+    // In incremental mode the edges after the graph are new insertions, and the weight is printed after each batch
+    if (incremental) {
+        incrementalMST(graph);
+        freeGraph(graph);
+        return 0;
     }
 
-    // Run Prim's algorithm to find the minimum spanning tree
-    int mst_weight = primMST(graph, num_edges_per_vertex, num_vertices);
+    // Run the chosen engine to find the minimum spanning tree
+    int mst_weight;
+    if (strcmp(engine, "dense") == 0)
+        mst_weight = densePrimMST(graph);
+    else if (strcmp(engine, "boruvka") == 0)
+        mst_weight = boruvkaMST(graph, num_threads);
+    else if (strcmp(engine, "kruskal") == 0)
+        mst_weight = kruskalMST(graph, num_threads);
+    else
+        mst_weight = primMST(graph);
 
     // Output the total weight of the MST
     printf("%d\n", mst_weight);
 
     // Free allocated memory
-    for (int i = 0; i < num_vertices; i++) {
-        free(graph[i]);
-    }
-    free(graph);
-    free(num_edges_per_vertex);
+    freeGraph(graph);
 
     return 0;
 
-}
\ No newline at end of file
+}
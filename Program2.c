@@ -3,6 +3,10 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <limits.h>
+#include <string.h>
+#include <pthread.h>   // Batch mode runs queries on several threads, so compile with -pthread
+#include <stdatomic.h>
+#include <unistd.h>
 
 #define INF INT_MAX // Infinite distance
 
@@ -12,90 +16,1348 @@ struct Edge {
     int length;
 };
 
-// Function to find the vertex with the smallest distance
-int find_min_distance(int dist[], int visited[], int num_vertices) {
-    int min = INF, min_index;
+// Structure to represent the whole graph in compressed sparse row form
+// The edges leaving vertex u are edges[offsets[u]] up to (but not including) edges[offsets[u + 1]]
+struct Graph {
+    int num_vertices;
+    int *offsets;
+    struct Edge *edges;
+};
 
-    for (int v = 0; v < num_vertices; v++) {
-        if (!visited[v] && dist[v] <= min) {
-            min = dist[v];
-            min_index = v;
+// Function to read `num_edges` directed edges and build the compressed graph in two passes
+// The first pass counts the out-degree of every vertex, the second drops each edge into its slot
+struct Graph* read_graph(int num_vertices, int num_edges) {
+    int *from = (int *)malloc(num_edges * sizeof(int));
+    struct Edge *list = (struct Edge *)malloc(num_edges * sizeof(struct Edge));
+    struct Graph *graph = (struct Graph *)malloc(sizeof(struct Graph));
+    graph->num_vertices = num_vertices;
+    graph->offsets = (int *)calloc(num_vertices + 1, sizeof(int));
+    graph->edges = (struct Edge *)malloc(num_edges * sizeof(struct Edge));
+
+    // Read edges and count the out-degree of each vertex
+    for (int i = 0; i < num_edges; i++) {
+        int u, v, length;
+        if (scanf("%d %d %d", &u, &v, &length) != 3) {
+            fprintf(stderr, "Error reading edge.\n");
+            exit(1);
+        }
+        if (u < 0 || u >= num_vertices || v < 0 || v >= num_vertices) {
+            fprintf(stderr, "Edge %d %d is out of range.\n", u, v);
+            exit(1);
         }
+        if (length < 0) {
+            fprintf(stderr, "Edge %d %d has a negative length.\n", u, v);
+            exit(1);
+        }
+        from[i] = u;
+        list[i].to = v;
+        list[i].length = length;
+        graph->offsets[u + 1]++;
+    }
+
+    // Turn the degree counts into starting offsets
+    for (int u = 0; u < num_vertices; u++) {
+        graph->offsets[u + 1] += graph->offsets[u];
+    }
+
+    // Fill each vertex's slots in order, using a cursor that starts at its offset
+    int *fill = (int *)malloc(num_vertices * sizeof(int));
+    for (int u = 0; u < num_vertices; u++) {
+        fill[u] = graph->offsets[u];
+    }
+    for (int i = 0; i < num_edges; i++) {
+        graph->edges[fill[from[i]]++] = list[i];
     }
-    return min_index;
+
+    free(fill);
+    free(from);
+    free(list);
+    return graph;
 }
 
-// Dijkstra's algorithm to find the shortest path from start to end
-int dijkstra(int start, int end, struct Edge** graph, int* num_edges, int num_vertices) {
-    int* dist = (int*)malloc(num_vertices * sizeof(int));   // Distance array
-    int* visited = (int*)malloc(num_vertices * sizeof(int)); // Visited array
+// Function to free a graph built by read_graph
+void free_graph(struct Graph *graph) {
+    free(graph->offsets);
+    free(graph->edges);
+    free(graph);
+}
+
+#define RADIX_BUCKETS 33 // One bucket for keys equal to the last popped key, plus one per differing bit
+
+// Structure to hold one queued vertex and the distance it was queued with
+struct HeapItem {
+    unsigned int key;
+    int vertex;
+};
+
+// Structure to represent one growable bucket of a radix heap
+struct RadixBucket {
+    struct HeapItem *items;
+    int size;
+    int capacity;
+};
+
+// Structure to represent a radix heap, a monotone priority queue for non-negative integer keys
+// An item sits in the bucket numbered by the highest bit where its key differs from the last popped key,
+// so items only ever move to lower buckets and each one is moved at most 32 times
+struct RadixHeap {
+    struct RadixBucket buckets[RADIX_BUCKETS];
+    unsigned int last;
+    int size;
+};
+
+// Function to set up an empty radix heap
+void radix_heap_init(struct RadixHeap *heap) {
+    for (int b = 0; b < RADIX_BUCKETS; b++) {
+        heap->buckets[b].items = NULL;
+        heap->buckets[b].size = 0;
+        heap->buckets[b].capacity = 0;
+    }
+    heap->last = 0;
+    heap->size = 0;
+}
+
+// Function to empty a radix heap but keep its buckets allocated for the next search
+void radix_heap_clear(struct RadixHeap *heap) {
+    for (int b = 0; b < RADIX_BUCKETS; b++) {
+        heap->buckets[b].size = 0;
+    }
+    heap->last = 0;
+    heap->size = 0;
+}
+
+// Function to free the buckets of a radix heap
+void radix_heap_free(struct RadixHeap *heap) {
+    for (int b = 0; b < RADIX_BUCKETS; b++) {
+        free(heap->buckets[b].items);
+    }
+}
+
+// Function to find which bucket a key belongs in
+int radix_bucket(unsigned int key, unsigned int last) {
+    return key == last ? 0 : 32 - __builtin_clz(key ^ last);
+}
+
+// Function to add an item to a bucket, doubling the bucket when it is full
+void radix_bucket_push(struct RadixBucket *bucket, unsigned int key, int vertex) {
+    if (bucket->size == bucket->capacity) {
+        bucket->capacity = bucket->capacity ? 2 * bucket->capacity : 16;
+        bucket->items = (struct HeapItem *)realloc(bucket->items, bucket->capacity * sizeof(struct HeapItem));
+    }
+    bucket->items[bucket->size].key = key;
+    bucket->items[bucket->size].vertex = vertex;
+    bucket->size++;
+}
 
+// Function to queue `vertex` with distance `key`, which must not be smaller than the last popped key
+void radix_heap_push(struct RadixHeap *heap, unsigned int key, int vertex) {
+    radix_bucket_push(&heap->buckets[radix_bucket(key, heap->last)], key, vertex);
+    heap->size++;
+}
+
+// Function to find the smallest key in a non-empty radix heap
+// The items with that key end up in bucket 0, ready to be popped
+unsigned int radix_heap_min_key(struct RadixHeap *heap) {
+    if (heap->buckets[0].size == 0) {
+        // Find the first non-empty bucket and the smallest key inside it
+        int b = 1;
+        while (heap->buckets[b].size == 0)
+            b++;
+        struct RadixBucket *bucket = &heap->buckets[b];
+        unsigned int min_key = bucket->items[0].key;
+        for (int i = 1; i < bucket->size; i++) {
+            if (bucket->items[i].key < min_key)
+                min_key = bucket->items[i].key;
+        }
+
+        // Move everything in that bucket down, now measured against the new smallest key
+        heap->last = min_key;
+        for (int i = 0; i < bucket->size; i++) {
+            struct HeapItem item = bucket->items[i];
+            radix_bucket_push(&heap->buckets[radix_bucket(item.key, min_key)], item.key, item.vertex);
+        }
+        bucket->size = 0;
+    }
+    return heap->last;
+}
+
+// Function to remove an item with the smallest key from a non-empty radix heap
+struct HeapItem radix_heap_pop(struct RadixHeap *heap) {
+    radix_heap_min_key(heap);
+    heap->size--;
+    return heap->buckets[0].items[--heap->buckets[0].size];
+}
+
+// Structure to hold the per-search working memory, so one thread can run many searches without reallocating
+// Only the vertices a search touched are reset afterwards, which keeps short queries cheap on huge graphs
+struct DijkstraScratch {
+    int *dist;     // Distance array
+    char *visited; // Visited array
+    int *touched;  // Vertices whose distance was changed by the current search
+    int touched_count;
+    struct RadixHeap heap;
+};
+
+// Function to allocate scratch space for searches on a graph with `num_vertices` vertices
+struct DijkstraScratch* create_scratch(int num_vertices) {
+    struct DijkstraScratch *scratch = (struct DijkstraScratch *)malloc(sizeof(struct DijkstraScratch));
+    scratch->dist = (int *)malloc(num_vertices * sizeof(int));
+    scratch->visited = (char *)calloc(num_vertices, sizeof(char));
+    scratch->touched = (int *)malloc(num_vertices * sizeof(int));
+    scratch->touched_count = 0;
     for (int i = 0; i < num_vertices; i++) {
-        dist[i] = INF;
-        visited[i] = 0;
+        scratch->dist[i] = INF;
+    }
+    radix_heap_init(&scratch->heap);
+    return scratch;
+}
+
+// Function to free scratch space made by create_scratch
+void free_scratch(struct DijkstraScratch *scratch) {
+    free(scratch->dist);
+    free(scratch->visited);
+    free(scratch->touched);
+    radix_heap_free(&scratch->heap);
+    free(scratch);
+}
+
+// Function to put scratch space back the way create_scratch left it
+void reset_scratch(struct DijkstraScratch *scratch) {
+    for (int i = 0; i < scratch->touched_count; i++) {
+        scratch->dist[scratch->touched[i]] = INF;
+        scratch->visited[scratch->touched[i]] = 0;
     }
+    scratch->touched_count = 0;
+    radix_heap_clear(&scratch->heap);
+}
+
+// Dijkstra's algorithm to find the shortest path from start to end, using caller-provided scratch space
+// Vertices come out of a radix heap in distance order, and the search stops as soon as `end` is settled
+int dijkstra_with_scratch(int start, int end, struct Graph* graph, struct DijkstraScratch *scratch) {
+    int *dist = scratch->dist;
+    char *visited = scratch->visited;
+    struct RadixHeap *heap = &scratch->heap;
+
     dist[start] = 0;
+    scratch->touched[scratch->touched_count++] = start;
+    radix_heap_push(heap, 0, start);
 
-    for (int i = 0; i < num_vertices - 1; i++) {
-        int u = find_min_distance(dist, visited, num_vertices);
+    while (heap->size > 0) {
+        int u = radix_heap_pop(heap).vertex;
+
+        // A vertex may be queued more than once, only its first (shortest) copy counts
+        if (visited[u])
+            continue;
         visited[u] = 1;
+        if (u == end)
+            break;
 
         // Update distance for adjacent vertices
-        for (int j = 0; j < num_edges[u]; j++) {
-            int v = graph[u][j].to;
-            int weight = graph[u][j].length;
-            if (!visited[v] && dist[u] != INF && dist[u] + weight < dist[v]) {
-                dist[v] = dist[u] + weight;
+        for (int j = graph->offsets[u]; j < graph->offsets[u + 1]; j++) {
+            int v = graph->edges[j].to;
+            long long new_dist = (long long)dist[u] + graph->edges[j].length;
+            if (!visited[v] && new_dist < dist[v]) {
+                if (dist[v] == INF)
+                    scratch->touched[scratch->touched_count++] = v;
+                dist[v] = (int)new_dist;
+                radix_heap_push(heap, dist[v], v);
             }
         }
     }
 
     int result = dist[end];
-    free(dist);
-    free(visited);
+    reset_scratch(scratch);
     return (result == INF) ? -1 : result; // Return -1 if unreachable
 }
 
-int main(int argc, char *argv[]) {
-    int num_vertices, num_edges;
+// Dijkstra's algorithm to find the shortest path from start to end
+int dijkstra(int start, int end, struct Graph* graph) {
+    struct DijkstraScratch *scratch = create_scratch(graph->num_vertices);
+    int result = dijkstra_with_scratch(start, end, graph, scratch);
+    free_scratch(scratch);
+    return result;
+}
 
-    if(argc!=3)
-    {
-        printf("Usage: %s <start_vertex> <end_vertex> < inputfile\n", argv[0]);
+// Function to build the reverse of a graph, where every edge u -> v becomes v -> u
+// Bidirectional search walks this one backwards from `end`
+struct Graph* reverse_graph(struct Graph *graph) {
+    int num_vertices = graph->num_vertices;
+    int num_edges = graph->offsets[num_vertices];
+    struct Graph *reverse = (struct Graph *)malloc(sizeof(struct Graph));
+    reverse->num_vertices = num_vertices;
+    reverse->offsets = (int *)calloc(num_vertices + 1, sizeof(int));
+    reverse->edges = (struct Edge *)malloc(num_edges * sizeof(struct Edge));
+
+    // Count the in-degree of each vertex and turn the counts into starting offsets
+    for (int i = 0; i < num_edges; i++) {
+        reverse->offsets[graph->edges[i].to + 1]++;
+    }
+    for (int u = 0; u < num_vertices; u++) {
+        reverse->offsets[u + 1] += reverse->offsets[u];
+    }
+
+    // Fill each vertex's slots in order, using a cursor that starts at its offset
+    int *fill = (int *)malloc(num_vertices * sizeof(int));
+    for (int u = 0; u < num_vertices; u++) {
+        fill[u] = reverse->offsets[u];
+    }
+    for (int u = 0; u < num_vertices; u++) {
+        for (int j = graph->offsets[u]; j < graph->offsets[u + 1]; j++) {
+            int slot = fill[graph->edges[j].to]++;
+            reverse->edges[slot].to = u;
+            reverse->edges[slot].length = graph->edges[j].length;
+        }
+    }
+
+    free(fill);
+    return reverse;
+}
+
+// Bidirectional Dijkstra to find the shortest path from start to end
+// One search runs forward from `start` on `graph`, the other backward from `end` on `reverse`, and each step
+// advances whichever frontier is closer. `best` tracks the shortest start-to-end path seen where the two meet,
+// and the search stops once the two frontier distances add up to at least `best`
+int bidirectional_dijkstra(int start, int end, struct Graph *graph, struct Graph *reverse,
+                           struct DijkstraScratch *forward, struct DijkstraScratch *backward) {
+    struct DijkstraScratch *sides[2] = { forward, backward };
+    struct Graph *graphs[2] = { graph, reverse };
+    long long best = INF;
+
+    forward->dist[start] = 0;
+    forward->touched[forward->touched_count++] = start;
+    radix_heap_push(&forward->heap, 0, start);
+    backward->dist[end] = 0;
+    backward->touched[backward->touched_count++] = end;
+    radix_heap_push(&backward->heap, 0, end);
+    if (start == end)
+        best = 0;
+
+    // Once either side runs dry, every path it could still help with has already been counted
+    while (forward->heap.size > 0 && backward->heap.size > 0) {
+        unsigned int forward_key = radix_heap_min_key(&forward->heap);
+        unsigned int backward_key = radix_heap_min_key(&backward->heap);
+        if ((long long)forward_key + backward_key >= best)
+            break;
+
+        int side = forward_key <= backward_key ? 0 : 1;
+        struct DijkstraScratch *self = sides[side];
+        struct DijkstraScratch *other = sides[!side];
+        struct Graph *g = graphs[side];
+
+        int u = radix_heap_pop(&self->heap).vertex;
+
+        // A vertex may be queued more than once, only its first (shortest) copy counts
+        if (self->visited[u])
+            continue;
+        self->visited[u] = 1;
+
+        // Update distance for adjacent vertices and check whether the other side has already reached them
+        for (int j = g->offsets[u]; j < g->offsets[u + 1]; j++) {
+            int v = g->edges[j].to;
+            long long new_dist = (long long)self->dist[u] + g->edges[j].length;
+            if (!self->visited[v] && new_dist < self->dist[v]) {
+                if (self->dist[v] == INF)
+                    self->touched[self->touched_count++] = v;
+                self->dist[v] = (int)new_dist;
+                radix_heap_push(&self->heap, self->dist[v], v);
+            }
+            if (other->dist[v] != INF && new_dist + other->dist[v] < best)
+                best = new_dist + other->dist[v];
+        }
+    }
+
+    reset_scratch(forward);
+    reset_scratch(backward);
+    return (best >= INF) ? -1 : (int)best; // Return -1 if unreachable
+}
+
+#define WITNESS_SETTLE_LIMIT 500 // Witness searches give up after settling this many vertices
+#define CH_MAGIC 0x31484348      // "CHH1", marks a contraction hierarchy file
+
+// Structure to represent one growable adjacency list used while contracting
+struct AdjList {
+    struct Edge *edges;
+    int size;
+    int capacity;
+};
+
+// Structure to represent the graph that is still being contracted
+// For in-lists, `to` holds the vertex the edge comes from
+struct ContractionGraph {
+    int num_vertices;
+    struct AdjList *out;
+    struct AdjList *in;
+    struct AdjList *up;   // Finished hierarchy edges leading to higher vertices, searched forward
+    struct AdjList *down; // Finished hierarchy edges coming from higher vertices, stored turned around
+    int *deleted_neighbors;
+    int *target_of;       // `target_of[w] == u` while the witness search from u still has to reach w
+};
+
+// Structure to hold a shortcut found while contracting a vertex
+struct Shortcut {
+    int from;
+    int to;
+    int length;
+};
+
+// Structure to represent a binary min-heap of (priority, vertex) pairs used to pick the contraction order
+// Priorities can be negative, so this cannot be a radix heap
+struct OrderHeap {
+    struct HeapItem *items; // `key` is read as a signed priority here
+    int size;
+};
+
+// Function to add an edge to an adjacency list, doubling the list when it is full
+void adj_push(struct AdjList *list, int to, int length) {
+    if (list->size == list->capacity) {
+        list->capacity = list->capacity ? 2 * list->capacity : 4;
+        list->edges = (struct Edge *)realloc(list->edges, list->capacity * sizeof(struct Edge));
+    }
+    list->edges[list->size].to = to;
+    list->edges[list->size].length = length;
+    list->size++;
+}
+
+// Function to remove the edge to `to` from an adjacency list by moving the last edge into its slot
+void adj_remove(struct AdjList *list, int to) {
+    for (int i = 0; i < list->size; i++) {
+        if (list->edges[i].to == to) {
+            list->edges[i] = list->edges[--list->size];
+            return;
+        }
+    }
+}
+
+// Function to make `u -> w` at most `length` long, adding the edge if it is missing
+void add_or_shorten(struct ContractionGraph *cg, int u, int w, int length) {
+    for (int i = 0; i < cg->out[u].size; i++) {
+        if (cg->out[u].edges[i].to == w) {
+            if (length < cg->out[u].edges[i].length) {
+                cg->out[u].edges[i].length = length;
+                for (int j = 0; j < cg->in[w].size; j++) {
+                    if (cg->in[w].edges[j].to == u)
+                        cg->in[w].edges[j].length = length;
+                }
+            }
+            return;
+        }
+    }
+    adj_push(&cg->out[u], w, length);
+    adj_push(&cg->in[w], u, length);
+}
+
+// Function to copy a graph into growable lists, dropping self loops and keeping only the shortest parallel edge
+struct ContractionGraph* create_contraction_graph(struct Graph *graph) {
+    int num_vertices = graph->num_vertices;
+    struct ContractionGraph *cg = (struct ContractionGraph *)malloc(sizeof(struct ContractionGraph));
+    cg->num_vertices = num_vertices;
+    cg->out = (struct AdjList *)calloc(num_vertices, sizeof(struct AdjList));
+    cg->in = (struct AdjList *)calloc(num_vertices, sizeof(struct AdjList));
+    cg->up = (struct AdjList *)calloc(num_vertices, sizeof(struct AdjList));
+    cg->down = (struct AdjList *)calloc(num_vertices, sizeof(struct AdjList));
+    cg->deleted_neighbors = (int *)calloc(num_vertices, sizeof(int));
+    cg->target_of = (int *)malloc(num_vertices * sizeof(int));
+
+    // `seen[v] == u` means u already has an edge to v, sitting at out[u].edges[slot[v]]
+    int *seen = (int *)malloc(num_vertices * sizeof(int));
+    int *slot = (int *)malloc(num_vertices * sizeof(int));
+    for (int v = 0; v < num_vertices; v++) {
+        seen[v] = -1;
+        cg->target_of[v] = -1;
+    }
+    for (int u = 0; u < num_vertices; u++) {
+        for (int j = graph->offsets[u]; j < graph->offsets[u + 1]; j++) {
+            int v = graph->edges[j].to;
+            int length = graph->edges[j].length;
+            if (v == u)
+                continue;
+            if (seen[v] == u) {
+                if (length < cg->out[u].edges[slot[v]].length)
+                    cg->out[u].edges[slot[v]].length = length;
+            } else {
+                seen[v] = u;
+                slot[v] = cg->out[u].size;
+                adj_push(&cg->out[u], v, length);
+            }
+        }
+    }
+    for (int u = 0; u < num_vertices; u++) {
+        for (int i = 0; i < cg->out[u].size; i++) {
+            adj_push(&cg->in[cg->out[u].edges[i].to], u, cg->out[u].edges[i].length);
+        }
+    }
+
+    free(seen);
+    free(slot);
+    return cg;
+}
+
+// Function to free a contraction graph and all of its lists
+void free_contraction_graph(struct ContractionGraph *cg) {
+    for (int v = 0; v < cg->num_vertices; v++) {
+        free(cg->out[v].edges);
+        free(cg->in[v].edges);
+        free(cg->up[v].edges);
+        free(cg->down[v].edges);
+    }
+    free(cg->out);
+    free(cg->in);
+    free(cg->up);
+    free(cg->down);
+    free(cg->deleted_neighbors);
+    free(cg->target_of);
+    free(cg);
+}
+
+// Function to run a Dijkstra from `source` in the uncontracted graph that never passes through `skip`
+// It stops once all `num_targets` vertices marked in target_of are settled, past `max_dist`, or after
+// WITNESS_SETTLE_LIMIT vertices, so the distances it leaves are upper bounds
+void witness_search(struct ContractionGraph *cg, int source, int skip, long long max_dist, int num_targets, struct DijkstraScratch *scratch) {
+    int settled = 0;
+    scratch->dist[source] = 0;
+    scratch->touched[scratch->touched_count++] = source;
+    radix_heap_push(&scratch->heap, 0, source);
+
+    while (scratch->heap.size > 0 && settled < WITNESS_SETTLE_LIMIT) {
+        struct HeapItem item = radix_heap_pop(&scratch->heap);
+        int x = item.vertex;
+        if (scratch->visited[x])
+            continue;
+        if (item.key > max_dist)
+            break;
+        scratch->visited[x] = 1;
+        settled++;
+        if (cg->target_of[x] == source && --num_targets == 0)
+            break;
+
+        for (int i = 0; i < cg->out[x].size; i++) {
+            int y = cg->out[x].edges[i].to;
+            long long new_dist = (long long)scratch->dist[x] + cg->out[x].edges[i].length;
+            if (y != skip && !scratch->visited[y] && new_dist < scratch->dist[y]) {
+                if (scratch->dist[y] == INF)
+                    scratch->touched[scratch->touched_count++] = y;
+                scratch->dist[y] = (int)new_dist;
+                radix_heap_push(&scratch->heap, scratch->dist[y], y);
+            }
+        }
+    }
+}
+
+// Function to find the shortcuts that contracting `v` would need, returns how many there are
+// A shortcut u -> w is needed unless a witness search finds a path from u to w avoiding v that is no longer than u -> v -> w
+int find_shortcuts(struct ContractionGraph *cg, int v, struct DijkstraScratch *scratch, struct Shortcut **shortcuts, int *capacity) {
+    int count = 0;
+    struct AdjList *in = &cg->in[v];
+    struct AdjList *out = &cg->out[v];
+
+    for (int i = 0; i < in->size; i++) {
+        int u = in->edges[i].to;
+        int to_v = in->edges[i].length;
+
+        // Search only as far as the longest path through v could reach, and only until every w is settled
+        long long max_dist = -1;
+        int num_targets = 0;
+        for (int j = 0; j < out->size; j++) {
+            int w = out->edges[j].to;
+            if (w == u)
+                continue;
+            cg->target_of[w] = u;
+            num_targets++;
+            if ((long long)to_v + out->edges[j].length > max_dist)
+                max_dist = (long long)to_v + out->edges[j].length;
+        }
+        if (max_dist < 0)
+            continue;
+
+        witness_search(cg, u, v, max_dist, num_targets, scratch);
+        for (int j = 0; j < out->size; j++) {
+            int w = out->edges[j].to;
+            long long through_v = (long long)to_v + out->edges[j].length;
+            if (w == u || through_v >= INF || scratch->dist[w] <= through_v)
+                continue;
+            if (count == *capacity) {
+                *capacity = *capacity ? 2 * *capacity : 16;
+                *shortcuts = (struct Shortcut *)realloc(*shortcuts, *capacity * sizeof(struct Shortcut));
+            }
+            (*shortcuts)[count].from = u;
+            (*shortcuts)[count].to = w;
+            (*shortcuts)[count].length = (int)through_v;
+            count++;
+        }
+        reset_scratch(scratch);
+        for (int j = 0; j < out->size; j++) {
+            cg->target_of[out->edges[j].to] = -1;
+        }
+    }
+    return count;
+}
+
+// Function to score how attractive `v` is to contract next, lower goes first
+// This is the edge difference (shortcuts added minus edges removed) plus how many neighbours are already gone,
+// which spreads the contraction evenly over the graph
+int contraction_priority(struct ContractionGraph *cg, int v, struct DijkstraScratch *scratch, struct Shortcut **shortcuts, int *capacity) {
+    int added = find_shortcuts(cg, v, scratch, shortcuts, capacity);
+    return added - cg->in[v].size - cg->out[v].size + cg->deleted_neighbors[v];
+}
+
+// Function to contract `v`: its remaining edges become hierarchy edges, the shortcuts replace it, and it leaves the graph
+void contract_vertex(struct ContractionGraph *cg, int v, struct DijkstraScratch *scratch, struct Shortcut **shortcuts, int *capacity) {
+    int count = find_shortcuts(cg, v, scratch, shortcuts, capacity);
+
+    // Every neighbour left is contracted later, so it sits higher in the hierarchy than v
+    for (int j = 0; j < cg->out[v].size; j++) {
+        int w = cg->out[v].edges[j].to;
+        adj_push(&cg->up[v], w, cg->out[v].edges[j].length);
+        adj_remove(&cg->in[w], v);
+        cg->deleted_neighbors[w]++;
+    }
+    for (int i = 0; i < cg->in[v].size; i++) {
+        int u = cg->in[v].edges[i].to;
+        adj_push(&cg->down[v], u, cg->in[v].edges[i].length);
+        adj_remove(&cg->out[u], v);
+        cg->deleted_neighbors[u]++;
+    }
+
+    for (int k = 0; k < count; k++) {
+        add_or_shorten(cg, (*shortcuts)[k].from, (*shortcuts)[k].to, (*shortcuts)[k].length);
+    }
+
+    free(cg->out[v].edges);
+    free(cg->in[v].edges);
+    cg->out[v].edges = cg->in[v].edges = NULL;
+    cg->out[v].size = cg->out[v].capacity = 0;
+    cg->in[v].size = cg->in[v].capacity = 0;
+}
+
+// Function to add a (priority, vertex) pair to the order heap
+void order_heap_push(struct OrderHeap *heap, int priority, int vertex) {
+    int i = heap->size++;
+    while (i > 0 && (int)heap->items[(i - 1) / 2].key > priority) {
+        heap->items[i] = heap->items[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    heap->items[i].key = (unsigned int)priority;
+    heap->items[i].vertex = vertex;
+}
+
+// Function to remove the pair with the lowest priority from the order heap
+struct HeapItem order_heap_pop(struct OrderHeap *heap) {
+    struct HeapItem top = heap->items[0];
+    struct HeapItem last = heap->items[--heap->size];
+    int i = 0;
+    while (2 * i + 1 < heap->size) {
+        int child = 2 * i + 1;
+        if (child + 1 < heap->size && (int)heap->items[child + 1].key < (int)heap->items[child].key)
+            child++;
+        if ((int)heap->items[child].key >= (int)last.key)
+            break;
+        heap->items[i] = heap->items[child];
+        i = child;
+    }
+    heap->items[i] = last;
+    return top;
+}
+
+// Function to pack growable lists into a compressed graph
+struct Graph* lists_to_graph(struct AdjList *lists, int num_vertices) {
+    struct Graph *graph = (struct Graph *)malloc(sizeof(struct Graph));
+    graph->num_vertices = num_vertices;
+    graph->offsets = (int *)malloc((num_vertices + 1) * sizeof(int));
+    graph->offsets[0] = 0;
+    for (int v = 0; v < num_vertices; v++) {
+        graph->offsets[v + 1] = graph->offsets[v] + lists[v].size;
+    }
+    graph->edges = (struct Edge *)malloc((graph->offsets[num_vertices] + 1) * sizeof(struct Edge));
+    for (int v = 0; v < num_vertices; v++) {
+        if (lists[v].size > 0)
+            memcpy(graph->edges + graph->offsets[v], lists[v].edges, lists[v].size * sizeof(struct Edge));
+    }
+    return graph;
+}
+
+// Function to build a contraction hierarchy, returning the upward graph and the turned-around downward graph
+// Vertices are contracted one at a time in order of contraction_priority, which is checked again just before
+// contracting since it goes stale as neighbours disappear
+void build_hierarchy(struct Graph *graph, struct Graph **up, struct Graph **down) {
+    int num_vertices = graph->num_vertices;
+    struct ContractionGraph *cg = create_contraction_graph(graph);
+    struct DijkstraScratch *scratch = create_scratch(num_vertices);
+    struct Shortcut *shortcuts = NULL;
+    int capacity = 0;
+
+    struct OrderHeap order;
+    order.items = (struct HeapItem *)malloc((num_vertices + 1) * sizeof(struct HeapItem));
+    order.size = 0;
+    for (int v = 0; v < num_vertices; v++) {
+        order_heap_push(&order, contraction_priority(cg, v, scratch, &shortcuts, &capacity), v);
+    }
+
+    while (order.size > 0) {
+        int v = order_heap_pop(&order).vertex;
+        int priority = contraction_priority(cg, v, scratch, &shortcuts, &capacity);
+        if (order.size > 0 && priority > (int)order.items[0].key) {
+            order_heap_push(&order, priority, v); // Someone else is cheaper now, try v again later
+            continue;
+        }
+        contract_vertex(cg, v, scratch, &shortcuts, &capacity);
+    }
+
+    *up = lists_to_graph(cg->up, num_vertices);
+    *down = lists_to_graph(cg->down, num_vertices);
+
+    free(order.items);
+    free(shortcuts);
+    free_scratch(scratch);
+    free_contraction_graph(cg);
+}
+
+// Function to write a compressed graph to a binary file
+void write_graph_binary(FILE *file, struct Graph *graph) {
+    fwrite(&graph->num_vertices, sizeof(int), 1, file);
+    fwrite(graph->offsets, sizeof(int), graph->num_vertices + 1, file);
+    fwrite(graph->edges, sizeof(struct Edge), graph->offsets[graph->num_vertices], file);
+}
+
+// Function to read a compressed graph written by write_graph_binary, returns NULL if the file is cut short
+struct Graph* read_graph_binary(FILE *file) {
+    int num_vertices;
+    if (fread(&num_vertices, sizeof(int), 1, file) != 1 || num_vertices < 0)
+        return NULL;
+    struct Graph *graph = (struct Graph *)malloc(sizeof(struct Graph));
+    graph->num_vertices = num_vertices;
+    graph->offsets = (int *)malloc((num_vertices + 1) * sizeof(int));
+    graph->edges = NULL;
+    if (fread(graph->offsets, sizeof(int), num_vertices + 1, file) != (size_t)num_vertices + 1) {
+        free_graph(graph);
+        return NULL;
+    }
+    int num_edges = graph->offsets[num_vertices];
+    graph->edges = (struct Edge *)malloc((num_edges + 1) * sizeof(struct Edge));
+    if (fread(graph->edges, sizeof(struct Edge), num_edges, file) != (size_t)num_edges) {
+        free_graph(graph);
+        return NULL;
+    }
+    return graph;
+}
+
+// Function to save a contraction hierarchy so query runs can skip the preprocessing
+int save_hierarchy(const char *path, struct Graph *up, struct Graph *down) {
+    FILE *file = fopen(path, "wb");
+    if (!file) {
+        perror("Error opening hierarchy file");
         return 1;
     }
-    // Read number of vertices and edges
-    if (scanf("%d %d", &num_vertices, &num_edges) != 2) {
-        fprintf(stderr, "Error reading number of vertices and edges.\n");
+    int magic = CH_MAGIC;
+    fwrite(&magic, sizeof(int), 1, file);
+    write_graph_binary(file, up);
+    write_graph_binary(file, down);
+    if (fclose(file) != 0) {
+        perror("Error writing hierarchy file");
         return 1;
     }
+    return 0;
+}
 
-    // Allocate memory for the graph
-    struct Edge** graph = (struct Edge**)malloc(num_vertices * sizeof(struct Edge*));
-    int* num_edges_per_vertex = (int*)malloc(num_vertices * sizeof(int));
-    for (int i = 0; i < num_vertices; i++) {
-        graph[i] = (struct Edge*)malloc(num_edges * sizeof(struct Edge)); // Allocate space for edges
-        num_edges_per_vertex[i] = 0; // Initialize count of edges per vertex
+// Function to load a contraction hierarchy written by save_hierarchy
+int load_hierarchy(const char *path, struct Graph **up, struct Graph **down) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        perror("Error opening hierarchy file");
+        return 1;
+    }
+    int magic;
+    *up = *down = NULL;
+    if (fread(&magic, sizeof(int), 1, file) == 1 && magic == CH_MAGIC) {
+        *up = read_graph_binary(file);
+        if (*up)
+            *down = read_graph_binary(file);
+    }
+    fclose(file);
+    if (!*up || !*down || (*up)->num_vertices != (*down)->num_vertices) {
+        fprintf(stderr, "%s is not a contraction hierarchy file.\n", path);
+        if (*up)
+            free_graph(*up);
+        if (*down)
+            free_graph(*down);
+        return 1;
+    }
+    return 0;
+}
+
+// Contraction hierarchy query to find the shortest path from start to end
+// Both searches only climb: forward from `start` over `up`, backward from `end` over `down`. Each side keeps going
+// until its frontier is no closer than the best meeting found, since the top of the path can be settled late
+int hierarchy_query(int start, int end, struct Graph *up, struct Graph *down,
+                    struct DijkstraScratch *forward, struct DijkstraScratch *backward) {
+    struct DijkstraScratch *sides[2] = { forward, backward };
+    struct Graph *graphs[2] = { up, down };
+    long long best = INF;
+
+    forward->dist[start] = 0;
+    forward->touched[forward->touched_count++] = start;
+    radix_heap_push(&forward->heap, 0, start);
+    backward->dist[end] = 0;
+    backward->touched[backward->touched_count++] = end;
+    radix_heap_push(&backward->heap, 0, end);
+    if (start == end)
+        best = 0;
+
+    while (1) {
+        // Pick the side with the closer frontier among those that can still improve `best`
+        int side = -1;
+        long long side_key = best;
+        for (int s = 0; s < 2; s++) {
+            if (sides[s]->heap.size > 0) {
+                long long key = radix_heap_min_key(&sides[s]->heap);
+                if (key < side_key) {
+                    side = s;
+                    side_key = key;
+                }
+            }
+        }
+        if (side == -1)
+            break;
+
+        struct DijkstraScratch *self = sides[side];
+        struct DijkstraScratch *other = sides[!side];
+        struct Graph *g = graphs[side];
+
+        int u = radix_heap_pop(&self->heap).vertex;
+        if (self->visited[u])
+            continue;
+        self->visited[u] = 1;
+
+        for (int j = g->offsets[u]; j < g->offsets[u + 1]; j++) {
+            int v = g->edges[j].to;
+            long long new_dist = (long long)self->dist[u] + g->edges[j].length;
+            if (!self->visited[v] && new_dist < self->dist[v]) {
+                if (self->dist[v] == INF)
+                    self->touched[self->touched_count++] = v;
+                self->dist[v] = (int)new_dist;
+                radix_heap_push(&self->heap, self->dist[v], v);
+            }
+            if (other->dist[v] != INF && new_dist + other->dist[v] < best)
+                best = new_dist + other->dist[v];
+        }
+    }
+
+    reset_scratch(forward);
+    reset_scratch(backward);
+    return (best >= INF) ? -1 : (int)best; // Return -1 if unreachable
+}
+
+#define DELTA_CHUNK 64  // Frontier vertices a thread claims at a time during a light phase
+#define DELTA_RING 1024 // Buckets each thread keeps close at hand, anything further waits in a single far list
+
+// Structure to represent a growable list of vertices
+struct IntList {
+    int *items;
+    int size;
+    int capacity;
+};
+
+// Function to add a vertex to a list, doubling the list when it is full
+void int_list_push(struct IntList *list, int x) {
+    if (list->size == list->capacity) {
+        list->capacity = list->capacity ? 2 * list->capacity : 16;
+        list->items = (int *)realloc(list->items, list->capacity * sizeof(int));
+    }
+    list->items[list->size++] = x;
+}
+
+// Structure to hold the state every delta-stepping thread shares
+// Bucket b holds vertices whose distance lies in [b * delta, (b + 1) * delta). Buckets are settled in order:
+// light edges (length <= delta) are relaxed over and over until the bucket stops changing, then the heavy
+// edges of everything that passed through it are relaxed once, since they can only reach later buckets
+struct DeltaStepping {
+    struct Graph *graph;
+    int delta;
+    int num_threads;
+    _Atomic int *dist;
+    atomic_char *queued;  // Vertex is waiting in the frontier of the current bucket
+    atomic_char *removed; // Vertex was taken out of the current bucket and still needs its heavy edges relaxed
+    int *frontier;        // Vertices of the current bucket to process in this light phase
+    int *next_frontier;   // Vertices that fell into the current bucket during this light phase
+    atomic_int frontier_size;
+    atomic_int next_size;
+    atomic_int cursor;      // Next unclaimed frontier slot
+    atomic_int next_bucket; // Smallest non-empty bucket after the current one, found by all threads together
+    int bucket;
+    pthread_barrier_t barrier;
+};
+
+// Structure to hold what one delta-stepping thread keeps to itself
+struct DeltaWorker {
+    struct DeltaStepping *shared;
+    int id;
+    struct IntList bins[DELTA_RING]; // bins[b % DELTA_RING] holds vertices this thread dropped into bucket b, some may be stale
+    struct IntList far;              // Vertices dropped DELTA_RING or more buckets ahead of the current one
+    int far_min;                     // Smallest bucket anything in `far` was dropped into
+    struct IntList removed;          // Vertices this thread took out of the current bucket
+};
+
+// Function to lower dist[v] to `new_dist` if that is shorter, then file `v` under its new bucket
+// The compare-and-swap loop makes the update safe against other threads lowering the same distance
+void delta_relax(struct DeltaWorker *worker, int v, long long new_dist) {
+    struct DeltaStepping *shared = worker->shared;
+    if (new_dist >= INF)
+        return;
+    int current = atomic_load(&shared->dist[v]);
+    while (new_dist < current) {
+        if (atomic_compare_exchange_weak(&shared->dist[v], &current, (int)new_dist)) {
+            int b = (int)(new_dist / shared->delta);
+            if (b == shared->bucket) {
+                if (!atomic_exchange(&shared->queued[v], 1))
+                    shared->next_frontier[atomic_fetch_add(&shared->next_size, 1)] = v;
+            } else if (b - shared->bucket < DELTA_RING) {
+                int_list_push(&worker->bins[b % DELTA_RING], v);
+            } else {
+                int_list_push(&worker->far, v);
+                if (b < worker->far_min)
+                    worker->far_min = b;
+            }
+            return;
+        }
+    }
+}
+
+// Worker thread for delta-stepping, every thread runs the same bucket loop and meets the others at barriers
+void* delta_worker(void *arg) {
+    struct DeltaWorker *worker = (struct DeltaWorker *)arg;
+    struct DeltaStepping *shared = worker->shared;
+    struct Graph *graph = shared->graph;
+    int delta = shared->delta;
+
+    while (1) {
+        int bucket = shared->bucket;
+
+        // Once the ring reaches the far list, pull in whatever now fits and drop copies that were already settled
+        if (worker->far_min - bucket < DELTA_RING) {
+            int kept = 0;
+            worker->far_min = INT_MAX;
+            for (int i = 0; i < worker->far.size; i++) {
+                int v = worker->far.items[i];
+                int b = atomic_load(&shared->dist[v]) / delta;
+                if (b < bucket)
+                    continue;
+                if (b - bucket < DELTA_RING) {
+                    int_list_push(&worker->bins[b % DELTA_RING], v);
+                } else {
+                    worker->far.items[kept++] = v;
+                    if (b < worker->far_min)
+                        worker->far_min = b;
+                }
+            }
+            worker->far.size = kept;
+        }
+
+        // Move this thread's vertices for the current bucket into the shared frontier, skipping stale copies
+        struct IntList *bin = &worker->bins[bucket % DELTA_RING];
+        for (int i = 0; i < bin->size; i++) {
+            int v = bin->items[i];
+            if (atomic_load(&shared->dist[v]) / delta == bucket && !atomic_exchange(&shared->queued[v], 1))
+                shared->frontier[atomic_fetch_add(&shared->frontier_size, 1)] = v;
+        }
+        bin->size = 0;
+        pthread_barrier_wait(&shared->barrier);
+
+        // Light phases: relax light edges until no vertex lands in the current bucket again
+        while (atomic_load(&shared->frontier_size) > 0) {
+            int n = atomic_load(&shared->frontier_size);
+            int begin;
+            while ((begin = atomic_fetch_add(&shared->cursor, DELTA_CHUNK)) < n) {
+                int end = begin + DELTA_CHUNK < n ? begin + DELTA_CHUNK : n;
+                for (int k = begin; k < end; k++) {
+                    int u = shared->frontier[k];
+                    atomic_store(&shared->queued[u], 0);
+                    if (!atomic_exchange(&shared->removed[u], 1))
+                        int_list_push(&worker->removed, u);
+
+                    long long du = atomic_load(&shared->dist[u]);
+                    for (int j = graph->offsets[u]; j < graph->offsets[u + 1]; j++) {
+                        if (graph->edges[j].length <= delta)
+                            delta_relax(worker, graph->edges[j].to, du + graph->edges[j].length);
+                    }
+                }
+            }
+            pthread_barrier_wait(&shared->barrier);
+
+            // One thread swaps in the next frontier while the others wait
+            if (worker->id == 0) {
+                int *t = shared->frontier;
+                shared->frontier = shared->next_frontier;
+                shared->next_frontier = t;
+                atomic_store(&shared->frontier_size, atomic_load(&shared->next_size));
+                atomic_store(&shared->next_size, 0);
+                atomic_store(&shared->cursor, 0);
+            }
+            pthread_barrier_wait(&shared->barrier);
+        }
+
+        // Heavy phase: the distances in this bucket are final now, so relax their heavy edges once
+        for (int i = 0; i < worker->removed.size; i++) {
+            int u = worker->removed.items[i];
+            atomic_store(&shared->removed[u], 0);
+            long long du = atomic_load(&shared->dist[u]);
+            for (int j = graph->offsets[u]; j < graph->offsets[u + 1]; j++) {
+                if (graph->edges[j].length > delta)
+                    delta_relax(worker, graph->edges[j].to, du + graph->edges[j].length);
+            }
+        }
+        worker->removed.size = 0;
+        pthread_barrier_wait(&shared->barrier);
+
+        // Agree on the next bucket that any thread has something in, near or far
+        int local_next = worker->far_min;
+        for (int b = bucket + 1; b < bucket + DELTA_RING && b < local_next; b++) {
+            if (worker->bins[b % DELTA_RING].size > 0) {
+                local_next = b;
+                break;
+            }
+        }
+        int current = atomic_load(&shared->next_bucket);
+        while (local_next < current && !atomic_compare_exchange_weak(&shared->next_bucket, &current, local_next))
+            ;
+        pthread_barrier_wait(&shared->barrier);
+        int next = atomic_load(&shared->next_bucket);
+        if (next == INT_MAX)
+            break;
+        pthread_barrier_wait(&shared->barrier);
+        if (worker->id == 0) {
+            shared->bucket = next;
+            atomic_store(&shared->next_bucket, INT_MAX);
+        }
+        pthread_barrier_wait(&shared->barrier);
     }
+    return NULL;
+}
 
-    // Read edges
+// Function to pick a bucket width when none is given, the average edge length is a good middle ground
+// between too many nearly empty buckets and buckets that need many light phases
+int default_delta(struct Graph *graph) {
+    int num_edges = graph->offsets[graph->num_vertices];
+    long long total = 0;
     for (int i = 0; i < num_edges; i++) {
-        int u, v, length;
-        if (scanf("%d %d %d", &u, &v, &length) != 3) {
-            fprintf(stderr, "Error reading edge.\n");
+        total += graph->edges[i].length;
+    }
+    long long delta = num_edges > 0 ? (total + num_edges - 1) / num_edges : 1;
+    return delta < 1 ? 1 : (int)delta;
+}
+
+// Parallel delta-stepping to find the shortest distance from `source` to every vertex
+// Fills `result` with the distances, -1 for vertices that cannot be reached
+void delta_stepping(int source, struct Graph *graph, int delta, int num_threads, int *result) {
+    int num_vertices = graph->num_vertices;
+    struct DeltaStepping shared;
+    shared.graph = graph;
+    shared.delta = delta;
+    shared.num_threads = num_threads;
+    shared.dist = (_Atomic int *)malloc(num_vertices * sizeof(_Atomic int));
+    shared.queued = (atomic_char *)malloc(num_vertices * sizeof(atomic_char));
+    shared.removed = (atomic_char *)malloc(num_vertices * sizeof(atomic_char));
+    shared.frontier = (int *)malloc(num_vertices * sizeof(int));
+    shared.next_frontier = (int *)malloc(num_vertices * sizeof(int));
+    for (int v = 0; v < num_vertices; v++) {
+        atomic_init(&shared.dist[v], INF);
+        atomic_init(&shared.queued[v], 0);
+        atomic_init(&shared.removed[v], 0);
+    }
+    atomic_init(&shared.frontier_size, 0);
+    atomic_init(&shared.next_size, 0);
+    atomic_init(&shared.cursor, 0);
+    atomic_init(&shared.next_bucket, INT_MAX);
+    shared.bucket = 0;
+    pthread_barrier_init(&shared.barrier, NULL, num_threads);
+
+    struct DeltaWorker *workers = (struct DeltaWorker *)calloc(num_threads, sizeof(struct DeltaWorker));
+    for (int t = 0; t < num_threads; t++) {
+        workers[t].shared = &shared;
+        workers[t].id = t;
+        workers[t].far_min = INT_MAX;
+    }
+
+    // The source starts alone in bucket 0
+    atomic_store(&shared.dist[source], 0);
+    int_list_push(&workers[0].bins[0], source);
+
+    pthread_t *threads = (pthread_t *)malloc(num_threads * sizeof(pthread_t));
+    for (int t = 0; t < num_threads; t++) {
+        pthread_create(&threads[t], NULL, delta_worker, &workers[t]);
+    }
+    for (int t = 0; t < num_threads; t++) {
+        pthread_join(threads[t], NULL);
+    }
+
+    for (int v = 0; v < num_vertices; v++) {
+        int d = atomic_load(&shared.dist[v]);
+        result[v] = (d == INF) ? -1 : d;
+    }
+
+    // Free Memory
+    for (int t = 0; t < num_threads; t++) {
+        for (int b = 0; b < DELTA_RING; b++) {
+            free(workers[t].bins[b].items);
+        }
+        free(workers[t].far.items);
+        free(workers[t].removed.items);
+    }
+    free(workers);
+    free(threads);
+    pthread_barrier_destroy(&shared.barrier);
+    free(shared.dist);
+    free(shared.queued);
+    free(shared.removed);
+    free(shared.frontier);
+    free(shared.next_frontier);
+}
+
+// The ways a query can be answered
+enum QueryMode {
+    QUERY_DIJKSTRA,      // Plain Dijkstra on `graph`
+    QUERY_BIDIRECTIONAL, // Bidirectional Dijkstra, `reverse` is the reverse graph
+    QUERY_HIERARCHY      // Contraction hierarchy, `graph` and `reverse` are the upward and downward graphs
+};
+
+// Function to answer one query with the chosen method, `backward` is only used by the two-sided methods
+int answer_query(enum QueryMode mode, int start, int end, struct Graph *graph, struct Graph *reverse,
+                 struct DijkstraScratch *forward, struct DijkstraScratch *backward) {
+    if (mode == QUERY_HIERARCHY)
+        return hierarchy_query(start, end, graph, reverse, forward, backward);
+    if (mode == QUERY_BIDIRECTIONAL)
+        return bidirectional_dijkstra(start, end, graph, reverse, forward, backward);
+    return dijkstra_with_scratch(start, end, graph, forward);
+}
+
+// Structure to hold a batch of queries shared by every worker thread
+// The graph is only read, so the workers share it without locking and just claim query numbers from `next`
+struct QueryBatch {
+    enum QueryMode mode;
+    struct Graph *graph;
+    struct Graph *reverse; // Only set for the two-sided methods
+    int *starts;
+    int *ends;
+    int *results;
+    int num_queries;
+    atomic_int next;
+};
+
+// Worker thread that answers queries from the batch until none are left
+void* query_worker(void *arg) {
+    struct QueryBatch *batch = (struct QueryBatch *)arg;
+    struct DijkstraScratch *scratch = create_scratch(batch->graph->num_vertices);
+    struct DijkstraScratch *backward = batch->reverse ? create_scratch(batch->graph->num_vertices) : NULL;
+
+    int q;
+    while ((q = atomic_fetch_add(&batch->next, 1)) < batch->num_queries) {
+        batch->results[q] = answer_query(batch->mode, batch->starts[q], batch->ends[q], batch->graph, batch->reverse, scratch, backward);
+    }
+
+    free_scratch(scratch);
+    if (backward)
+        free_scratch(backward);
+    return NULL;
+}
+
+// Function to answer every `start end` pair in `query_file` and print the answers in the order they were asked
+int run_batch(const char *query_file, enum QueryMode mode, struct Graph *graph, struct Graph *reverse, int num_threads) {
+    FILE *input = fopen(query_file, "r");
+    if (!input) {
+        perror("Error opening query file");
+        return 1;
+    }
+
+    // Read the query pairs, growing the arrays as needed
+    struct QueryBatch batch;
+    int capacity = 1024;
+    batch.mode = mode;
+    batch.graph = graph;
+    batch.reverse = reverse;
+    batch.num_queries = 0;
+    batch.starts = (int *)malloc(capacity * sizeof(int));
+    batch.ends = (int *)malloc(capacity * sizeof(int));
+    int start_vertex, end_vertex;
+    while (fscanf(input, "%d %d", &start_vertex, &end_vertex) == 2) {
+        if (start_vertex < 0 || start_vertex >= graph->num_vertices || end_vertex < 0 || end_vertex >= graph->num_vertices) {
+            fprintf(stderr, "Query %d %d is out of range.\n", start_vertex, end_vertex);
+            fclose(input);
+            free(batch.starts);
+            free(batch.ends);
+            return 1;
+        }
+        if (batch.num_queries == capacity) {
+            capacity *= 2;
+            batch.starts = (int *)realloc(batch.starts, capacity * sizeof(int));
+            batch.ends = (int *)realloc(batch.ends, capacity * sizeof(int));
+        }
+        batch.starts[batch.num_queries] = start_vertex;
+        batch.ends[batch.num_queries] = end_vertex;
+        batch.num_queries++;
+    }
+    fclose(input);
+
+    batch.results = (int *)malloc((batch.num_queries + 1) * sizeof(int));
+    atomic_init(&batch.next, 0);
+
+    // Spread the queries across the worker pool
+    pthread_t *threads = (pthread_t *)malloc(num_threads * sizeof(pthread_t));
+    for (int t = 0; t < num_threads; t++) {
+        pthread_create(&threads[t], NULL, query_worker, &batch);
+    }
+    for (int t = 0; t < num_threads; t++) {
+        pthread_join(threads[t], NULL);
+    }
+
+    for (int q = 0; q < batch.num_queries; q++) {
+        if (batch.results[q] == -1) {
+            printf("unconnected\n");
+        } else {
+            printf("Shortest path distance: %d\n", batch.results[q]);
+        }
+    }
+
+    free(threads);
+    free(batch.results);
+    free(batch.starts);
+    free(batch.ends);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    int num_vertices, num_edges;
+    const char *query_file = NULL;
+    const char *build_file = NULL;     // Where --ch-build writes the hierarchy
+    const char *hierarchy_file = NULL; // Which hierarchy --ch answers queries from
+    const char *sssp_source = NULL;    // Where --sssp measures every distance from
+    int delta = 0;                     // Bucket width for --sssp, 0 picks one from the graph
+    int num_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    char *vertex_args[2];
+    int num_vertex_args = 0;
+    int bad_args = 0;
+    int bidirectional = 0;
+
+    // Options start with "--", anything else is the start or end vertex
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+            query_file = argv[++i];
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            num_threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--bidirectional") == 0) {
+            bidirectional = 1;
+        } else if (strcmp(argv[i], "--ch-build") == 0 && i + 1 < argc) {
+            build_file = argv[++i];
+        } else if (strcmp(argv[i], "--ch") == 0 && i + 1 < argc) {
+            hierarchy_file = argv[++i];
+        } else if (strcmp(argv[i], "--sssp") == 0 && i + 1 < argc) {
+            sssp_source = argv[++i];
+        } else if (strcmp(argv[i], "--delta") == 0 && i + 1 < argc) {
+            delta = atoi(argv[++i]);
+        } else if (strncmp(argv[i], "--", 2) != 0 && num_vertex_args < 2) {
+            vertex_args[num_vertex_args++] = argv[i];
+        } else {
+            bad_args = 1;
+        }
+    }
+    if (num_threads < 1)
+        num_threads = 1;
+
+    // A single query needs both vertices, batch mode takes its queries from a file instead, and building takes no queries
+    if (build_file)
+        bad_args |= query_file || hierarchy_file || bidirectional || sssp_source || num_vertex_args != 0;
+    else if (sssp_source)
+        bad_args |= query_file || hierarchy_file || bidirectional || num_vertex_args != 0 || delta < 0;
+    else
+        bad_args |= (hierarchy_file && bidirectional) || (query_file ? num_vertex_args != 0 : num_vertex_args != 2);
+    if (bad_args)
+    {
+        printf("Usage: %s [--bidirectional] <start_vertex> <end_vertex> < inputfile\n", argv[0]);
+        printf("       %s [--bidirectional] --batch <query_file> [--threads n] < inputfile\n", argv[0]);
+        printf("       %s --ch-build <hierarchy_file> < inputfile\n", argv[0]);
+        printf("       %s --ch <hierarchy_file> (<start_vertex> <end_vertex> | --batch <query_file> [--threads n])\n", argv[0]);
+        printf("       %s --sssp <source_vertex> [--delta d] [--threads n] < inputfile\n", argv[0]);
+        return 1;
+    }
+
+    struct Graph *graph;
+    struct Graph *reverse = NULL;
+    enum QueryMode mode = QUERY_DIJKSTRA;
+
+    if (hierarchy_file) {
+        // A hierarchy file already holds everything a query needs, so no graph is read from input
+        if (load_hierarchy(hierarchy_file, &graph, &reverse) != 0)
             return 1;
+        num_vertices = graph->num_vertices;
+        mode = QUERY_HIERARCHY;
+    } else {
+        // Read number of vertices and edges
+        if (scanf("%d %d", &num_vertices, &num_edges) != 2) {
+            fprintf(stderr, "Error reading number of vertices and edges.\n");
+            return 1;
+        }
+
+        // Read edges into a compressed graph, which takes O(V + E) memory
+        graph = read_graph(num_vertices, num_edges);
+
+        if (build_file) {
+            struct Graph *up, *down;
+            build_hierarchy(graph, &up, &down);
+            int status = save_hierarchy(build_file, up, down);
+            free_graph(up);
+            free_graph(down);
+            free_graph(graph);
+            return status;
+        }
+
+        // Delta-stepping prints the distance to every vertex, one per line, -1 if unreachable
+        if (sssp_source) {
+            int source = atoi(sssp_source);
+            if (source < 0 || source >= num_vertices) {
+                fprintf(stderr, "Source vertex is out of range.\n");
+                free_graph(graph);
+                return 1;
+            }
+            int *dist = (int *)malloc(num_vertices * sizeof(int));
+            delta_stepping(source, graph, delta > 0 ? delta : default_delta(graph), num_threads, dist);
+            for (int v = 0; v < num_vertices; v++) {
+                printf("%d\n", dist[v]);
+            }
+            free(dist);
+            free_graph(graph);
+            return 0;
+        }
+
+        // Bidirectional search also needs every edge turned around, built once here and shared by all queries
+        if (bidirectional) {
+            reverse = reverse_graph(graph);
+            mode = QUERY_BIDIRECTIONAL;
         }
-        graph[u][num_edges_per_vertex[u]].to = v;
-        graph[u][num_edges_per_vertex[u]].length = length;
-        num_edges_per_vertex[u]++;
+    }
+
+    if (query_file) {
+        int status = run_batch(query_file, mode, graph, reverse, num_threads);
+        free_graph(graph);
+        if (reverse)
+            free_graph(reverse);
+        return status;
     }
 
     // Read start and end vertices from the command line
-    start_vertex=(argv[1])
-    end_vertex=(argv[2])
+    int start_vertex = atoi(vertex_args[0]);
+    int end_vertex = atoi(vertex_args[1]);
+    if (start_vertex < 0 || start_vertex >= num_vertices || end_vertex < 0 || end_vertex >= num_vertices) {
+        fprintf(stderr, "Start or end vertex is out of range.\n");
+        free_graph(graph);
+        if (reverse)
+            free_graph(reverse);
+        return 1;
+    }
 
     // Find the shortest path from start_vertex to end_vertex
-    int shortest_path = dijkstra(start_vertex, end_vertex, graph, num_edges_per_vertex, num_vertices);
+    struct DijkstraScratch *forward = create_scratch(num_vertices);
+    struct DijkstraScratch *backward = reverse ? create_scratch(num_vertices) : NULL;
+    int shortest_path = answer_query(mode, start_vertex, end_vertex, graph, reverse, forward, backward);
+    free_scratch(forward);
+    if (backward)
+        free_scratch(backward);
 
     if (shortest_path == -1) {
         printf("unconnected\n");
@@ -104,11 +1366,9 @@ int main(int argc, char *argv[]) {
     }
 
     // Free allocated memory
-    for (int i = 0; i < num_vertices; i++) {
-        free(graph[i]);
-    }
-    free(graph);
-    free(num_edges_per_vertex);
+    free_graph(graph);
+    if (reverse)
+        free_graph(reverse);
 
     return 0;
 }
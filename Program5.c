@@ -3,82 +3,965 @@
 #include <stdlib.h>
 #include <string.h>
 #include <limits.h>
+#include <pthread.h>   // The parallel push-relabel engine uses threads, so compile with -pthread
+#include <stdatomic.h>
 
-#define MAX_VERTICES 10000000  // Adjust based on expected graph size
+// Structure to represent one arc of the residual graph
+// Every arc is stored next to the other arcs leaving the same vertex, and `rev` is the index of its partner arc
+// going the other way, so pushing flow along an arc is two array updates
+struct Arc {
+    int to;
+    int rev;
+    long long capacity; // Residual capacity left on this arc
+};
+
+// Structure to represent the residual graph in compressed sparse row form
+// The arcs leaving vertex u are arcs[offsets[u]] up to (but not including) arcs[offsets[u + 1]]
+struct FlowNetwork {
+    int numVertices;
+    int *offsets;
+    struct Arc *arcs;
+};
+
+// Structure to hold one input edge while the network is being built
+// Edges are stored with a < b, so u -> v and v -> u land on the same pair and share one arc pair
+struct EdgePair {
+    int a, b;
+    long long forward;  // Capacity from a to b
+    long long backward; // Capacity from b to a
+};
+
+// Function to order edge pairs by their endpoints for qsort
+int compareEdgePairs(const void *x, const void *y) {
+    const struct EdgePair *p = (const struct EdgePair *)x;
+    const struct EdgePair *q = (const struct EdgePair *)y;
+    if (p->a != q->a)
+        return (p->a > q->a) - (p->a < q->a);
+    return (p->b > q->b) - (p->b < q->b);
+}
+
+// Function to read `numEdges` edges and build the residual graph, which takes O(V + E) memory
+// Parallel edges are added together and u -> v shares its arc pair with v -> u, as the old matrix did
+struct FlowNetwork* readNetwork(int numVertices, int numEdges) {
+    struct EdgePair *pairs = (struct EdgePair *)malloc((numEdges + 1) * sizeof(struct EdgePair));
+    int numPairs = 0;
+
+    // Read the edges and capacities
+    for (int i = 0; i < numEdges; i++) {
+        int u, v, capacity;
+        if (scanf("%d %d %d", &u, &v, &capacity) != 3) {
+            fprintf(stderr, "Error reading edge.\n");
+            exit(1);
+        }
+        if (u < 0 || u >= numVertices || v < 0 || v >= numVertices) {
+            fprintf(stderr, "Edge %d %d is out of range.\n", u, v);
+            exit(1);
+        }
+        if (u == v)
+            continue; // A self loop can never carry flow toward the sink
+        pairs[numPairs].a = u < v ? u : v;
+        pairs[numPairs].b = u < v ? v : u;
+        pairs[numPairs].forward = u < v ? capacity : 0;
+        pairs[numPairs].backward = u < v ? 0 : capacity;
+        numPairs++;
+    }
+
+    // Sort so that every edge between the same two vertices sits together, then merge them
+    qsort(pairs, numPairs, sizeof(struct EdgePair), compareEdgePairs);
+    int merged = 0;
+    for (int i = 0; i < numPairs; i++) {
+        if (merged > 0 && pairs[merged - 1].a == pairs[i].a && pairs[merged - 1].b == pairs[i].b) {
+            pairs[merged - 1].forward += pairs[i].forward;
+            pairs[merged - 1].backward += pairs[i].backward;
+        } else {
+            pairs[merged++] = pairs[i];
+        }
+    }
+
+    // Count the arcs at each vertex and turn the counts into starting offsets
+    struct FlowNetwork *network = (struct FlowNetwork *)malloc(sizeof(struct FlowNetwork));
+    network->numVertices = numVertices;
+    network->offsets = (int *)calloc(numVertices + 1, sizeof(int));
+    network->arcs = (struct Arc *)malloc((2 * (size_t)merged + 1) * sizeof(struct Arc));
+    for (int i = 0; i < merged; i++) {
+        network->offsets[pairs[i].a + 1]++;
+        network->offsets[pairs[i].b + 1]++;
+    }
+    for (int u = 0; u < numVertices; u++) {
+        network->offsets[u + 1] += network->offsets[u];
+    }
+
+    // Fill each vertex's slots in order and tie every arc to its partner
+    int *fill = (int *)malloc(numVertices * sizeof(int));
+    for (int u = 0; u < numVertices; u++) {
+        fill[u] = network->offsets[u];
+    }
+    for (int i = 0; i < merged; i++) {
+        int ia = fill[pairs[i].a]++;
+        int ib = fill[pairs[i].b]++;
+        network->arcs[ia].to = pairs[i].b;
+        network->arcs[ia].rev = ib;
+        network->arcs[ia].capacity = pairs[i].forward;
+        network->arcs[ib].to = pairs[i].a;
+        network->arcs[ib].rev = ia;
+        network->arcs[ib].capacity = pairs[i].backward;
+    }
+
+    free(fill);
+    free(pairs);
+    return network;
+}
+
+// Function to free a network built by readNetwork
+void freeNetwork(struct FlowNetwork *network) {
+    free(network->offsets);
+    free(network->arcs);
+    free(network);
+}
 
 // Function to perform BFS and find an augmenting path
-int bfs(long long residualGraph[MAX_VERTICES][MAX_VERTICES], int source, int sink, int parent[], int numVertices) {
-    int *visited = (int *)malloc(numVertices * sizeof(int));  // Dynamically allocate memory for visited
-    memset(visited, 0, numVertices * sizeof(int));
+// parentArc[v] is set to the arc the path uses to reach v, and only arcs that actually exist are looked at
+int bfs(struct FlowNetwork *network, int source, int sink, int parentArc[], int visited[], int queue[]) {
+    memset(visited, 0, network->numVertices * sizeof(int));
 
-    int *queue = (int *)malloc(numVertices * sizeof(int));  // Dynamically allocate memory for queue
     int front = 0, rear = 0;
     queue[rear++] = source;
     visited[source] = 1;
-    parent[source] = -1;
+    parentArc[source] = -1;
     
     while (front < rear) {
         int u = queue[front++];
         
-        for (int v = 0; v < numVertices; v++) {
-            if (!visited[v] && residualGraph[u][v] > 0) {
+        for (int e = network->offsets[u]; e < network->offsets[u + 1]; e++) {
+            int v = network->arcs[e].to;
+            if (!visited[v] && network->arcs[e].capacity > 0) {
                 queue[rear++] = v;
-                parent[v] = u;
+                parentArc[v] = e;
                 visited[v] = 1;
                 
                 if (v == sink) {
-                    free(visited);
-                    free(queue);
                     return 1;  // Path found
                 }
             }
         }
     }
     
-    free(visited);  // Free allocated memory after usage
-    free(queue);
     return 0;  // No augmenting path
 }
 
-// Function to implement the Edmonds-Karp algorithm
-int edmondsKarp(int graph[MAX_VERTICES][MAX_VERTICES], int source, int sink, int numVertices) {
-    long long residualGraph[MAX_VERTICES][MAX_VERTICES];
-    int u, v;
+// Function to send up to `limit` units from `from` to `to` along shortest augmenting paths
+// Returns how much was sent, which is less than `limit` only when no augmenting path is left
+long long augmentPaths(struct FlowNetwork *network, int from, int to, long long limit, int parentArc[], int visited[], int queue[]) {
+    struct Arc *arcs = network->arcs;
+    long long sent = 0;
+
+    if (from == to)
+        return 0;
 
-    // Initialize the residual graph with the capacities
-    for (u = 0; u < numVertices; u++) {
-        for (v = 0; v < numVertices; v++) {
-            residualGraph[u][v] = graph[u][v];
-        }
-    }
-    
-    int *parent = (int *)malloc(numVertices * sizeof(int));  // Dynamically allocate memory for parent
-    int maxFlow = 0;
-    
     // Augment the flow while there is an augmenting path
-    while (bfs(residualGraph, source, sink, parent, numVertices)) {
-        // Find the minimum residual capacity of the edges along the path
-        int pathFlow = INT_MAX;
-        for (v = sink; v != source; v = parent[v]) {
-            u = parent[v];
-            pathFlow = (residualGraph[u][v] < pathFlow) ? residualGraph[u][v] : pathFlow;
+    while (sent < limit && bfs(network, from, to, parentArc, visited, queue)) {
+        // Find the minimum residual capacity of the arcs along the path
+        long long pathFlow = limit - sent;
+        for (int v = to; v != from; v = arcs[arcs[parentArc[v]].rev].to) {
+            long long capacity = arcs[parentArc[v]].capacity;
+            pathFlow = (capacity < pathFlow) ? capacity : pathFlow;
         }
 
-        // Update the residual capacities of the edges and reverse edges
-        for (v = sink; v != source; v = parent[v]) {
-            u = parent[v];
-            residualGraph[u][v] -= pathFlow;
-            residualGraph[v][u] += pathFlow;
+        // Update the residual capacities of the arcs and their partners
+        for (int v = to; v != from; v = arcs[arcs[parentArc[v]].rev].to) {
+            int e = parentArc[v];
+            arcs[e].capacity -= pathFlow;
+            arcs[arcs[e].rev].capacity += pathFlow;
         }
         
         // Add the path flow to the overall flow
-        maxFlow += pathFlow;
+        sent += pathFlow;
     }
+    return sent;
+}
+
+// Function to implement the Edmonds-Karp algorithm
+long long edmondsKarp(struct FlowNetwork *network, int source, int sink) {
+    int numVertices = network->numVertices;
+    int *parentArc = (int *)malloc(numVertices * sizeof(int));
+    int *visited = (int *)malloc(numVertices * sizeof(int));
+    int *queue = (int *)malloc(numVertices * sizeof(int));
+
+    long long maxFlow = augmentPaths(network, source, sink, LLONG_MAX, parentArc, visited, queue);
     
-    free(parent);  // Free allocated memory after usage
+    // Free allocated memory after usage
+    free(parentArc);
+    free(visited);
+    free(queue);
+    return maxFlow;
+}
+
+// Function to label every vertex with its BFS distance from the source over arcs with at least `threshold` left
+// Returns 1 if the sink was reached, which means the level graph still has a path to push flow along
+int buildLevels(struct FlowNetwork *network, int source, int sink, int level[], int queue[], long long threshold) {
+    for (int v = 0; v < network->numVertices; v++) {
+        level[v] = -1;
+    }
+
+    int front = 0, rear = 0;
+    queue[rear++] = source;
+    level[source] = 0;
+
+    while (front < rear) {
+        int u = queue[front++];
+        for (int e = network->offsets[u]; e < network->offsets[u + 1]; e++) {
+            int v = network->arcs[e].to;
+            if (level[v] == -1 && network->arcs[e].capacity >= threshold) {
+                level[v] = level[u] + 1;
+                queue[rear++] = v;
+            }
+        }
+    }
+    return level[sink] != -1;
+}
+
+// Function to find a blocking flow in the level graph with an iterative DFS
+// currentArc[u] remembers the first arc of u that might still lead to the sink, so every arc is given up on at most once
+long long blockingFlow(struct FlowNetwork *network, int source, int sink, int level[], int currentArc[], int path[], long long threshold) {
+    struct Arc *arcs = network->arcs;
+    long long totalFlow = 0;
+    int depth = 0;
+    int u = source;
+
+    for (int v = 0; v < network->numVertices; v++) {
+        currentArc[v] = network->offsets[v];
+    }
+
+    while (1) {
+        if (u == sink) {
+            // Push the bottleneck along the path on the stack
+            long long pathFlow = LLONG_MAX;
+            for (int k = 0; k < depth; k++) {
+                if (arcs[path[k]].capacity < pathFlow)
+                    pathFlow = arcs[path[k]].capacity;
+            }
+            for (int k = 0; k < depth; k++) {
+                arcs[path[k]].capacity -= pathFlow;
+                arcs[arcs[path[k]].rev].capacity += pathFlow;
+            }
+            totalFlow += pathFlow;
+
+            // Back up to the tail of the first arc that can no longer be used
+            for (int k = 0; k < depth; k++) {
+                if (arcs[path[k]].capacity < threshold) {
+                    depth = k;
+                    break;
+                }
+            }
+            u = depth == 0 ? source : arcs[path[depth - 1]].to;
+            continue;
+        }
+
+        // Advance along the first usable arc that goes one level deeper
+        int end = network->offsets[u + 1];
+        while (currentArc[u] < end) {
+            struct Arc *arc = &arcs[currentArc[u]];
+            if (arc->capacity >= threshold && level[arc->to] == level[u] + 1)
+                break;
+            currentArc[u]++;
+        }
+
+        if (currentArc[u] < end) {
+            path[depth++] = currentArc[u];
+            u = arcs[currentArc[u]].to;
+        } else {
+            // Dead end: no path to the sink goes through u any more, so retreat and skip the arc that led here
+            level[u] = -1;
+            if (depth == 0)
+                break;
+            int e = path[--depth];
+            u = arcs[arcs[e].rev].to;
+            currentArc[u]++;
+        }
+    }
+    return totalFlow;
+}
+
+// Function to implement Dinic's algorithm
+// With `scaling`, only arcs with at least `threshold` left are used, and the threshold halves from the largest
+// power of two down to 1, so big augmenting paths are found first
+long long dinic(struct FlowNetwork *network, int source, int sink, int scaling) {
+    int numVertices = network->numVertices;
+    int *level = (int *)malloc(numVertices * sizeof(int));
+    int *queue = (int *)malloc(numVertices * sizeof(int));
+    int *currentArc = (int *)malloc(numVertices * sizeof(int));
+    int *path = (int *)malloc(numVertices * sizeof(int));
+    long long maxFlow = 0;
+
+    long long threshold = 1;
+    if (scaling) {
+        long long largest = 0;
+        for (int e = 0; e < network->offsets[numVertices]; e++) {
+            if (network->arcs[e].capacity > largest)
+                largest = network->arcs[e].capacity;
+        }
+        while (threshold * 2 <= largest)
+            threshold *= 2;
+    }
+
+    if (source != sink) {
+        for (; threshold >= 1; threshold /= 2) {
+            while (buildLevels(network, source, sink, level, queue, threshold)) {
+                maxFlow += blockingFlow(network, source, sink, level, currentArc, path, threshold);
+            }
+        }
+    }
+
+    // Free allocated memory after usage
+    free(level);
+    free(queue);
+    free(currentArc);
+    free(path);
+    return maxFlow;
+}
+
+// Structure to hold the state of a sequential push-relabel run
+// Only the first phase is run: it finds a maximum preflow, whose excess at the sink is already the max flow value
+struct PushRelabel {
+    struct FlowNetwork *network;
+    int source, sink;
+    int highestLabel;  // 1 picks the active vertex with the greatest height, 0 works through them first in, first out
+    int *height;
+    long long *excess;
+    int *currentArc;
+    int *count;        // How many vertices sit at each height below V, used to spot gaps
+    char *active;      // Vertex is waiting in the queue or in a bucket
+    int *queue;        // FIFO ring of active vertices
+    int head, tail;
+    int *bucketHead;   // Highest-label buckets: a linked list of active vertices per height
+    int *bucketNext;
+    int maxHeight;     // No bucket above this height holds anything
+    int relabels;      // Relabels since the last global relabel
+};
+
+// Function to queue `v` for discharging if it has excess and can still reach the sink
+void addActive(struct PushRelabel *pr, int v) {
+    int numVertices = pr->network->numVertices;
+    if (v == pr->source || v == pr->sink || pr->active[v] || pr->excess[v] <= 0 || pr->height[v] >= numVertices)
+        return;
+    pr->active[v] = 1;
+    if (pr->highestLabel) {
+        pr->bucketNext[v] = pr->bucketHead[pr->height[v]];
+        pr->bucketHead[pr->height[v]] = v;
+        if (pr->height[v] > pr->maxHeight)
+            pr->maxHeight = pr->height[v];
+    } else {
+        pr->queue[pr->tail] = v;
+        pr->tail = (pr->tail + 1) % (numVertices + 1);
+    }
+}
+
+// Function to take the next vertex to discharge, or -1 if nothing is active
+int nextActive(struct PushRelabel *pr) {
+    int numVertices = pr->network->numVertices;
+    while (1) {
+        int v;
+        if (pr->highestLabel) {
+            while (pr->maxHeight >= 0 && pr->bucketHead[pr->maxHeight] == -1)
+                pr->maxHeight--;
+            if (pr->maxHeight < 0)
+                return -1;
+            v = pr->bucketHead[pr->maxHeight];
+            pr->bucketHead[pr->maxHeight] = pr->bucketNext[v];
+        } else {
+            if (pr->head == pr->tail)
+                return -1;
+            v = pr->queue[pr->head];
+            pr->head = (pr->head + 1) % (numVertices + 1);
+        }
+        pr->active[v] = 0;
+
+        // A gap may have lifted the vertex out of reach since it was queued
+        if (pr->height[v] < numVertices)
+            return v;
+    }
+}
+
+// Function to label every vertex with its residual distance to the sink, which is the tightest valid height
+// Vertices that cannot reach the sink any more get height V and are left alone from then on
+void globalRelabel(struct PushRelabel *pr) {
+    struct FlowNetwork *network = pr->network;
+    int numVertices = network->numVertices;
+    struct Arc *arcs = network->arcs;
+
+    for (int v = 0; v < numVertices; v++) {
+        pr->height[v] = numVertices;
+        pr->count[v] = 0;
+    }
+
+    // Reverse BFS from the sink: u is one step further than v if the arc u -> v still has room
+    int *queue = pr->currentArc; // Free to borrow, every current arc is reset below
+    int front = 0, rear = 0;
+    pr->height[pr->sink] = 0;
+    queue[rear++] = pr->sink;
+    while (front < rear) {
+        int v = queue[front++];
+        pr->count[pr->height[v]]++;
+        for (int e = network->offsets[v]; e < network->offsets[v + 1]; e++) {
+            int u = arcs[e].to;
+            if (pr->height[u] == numVertices && u != pr->source && arcs[arcs[e].rev].capacity > 0) {
+                pr->height[u] = pr->height[v] + 1;
+                queue[rear++] = u;
+            }
+        }
+    }
+    pr->height[pr->source] = numVertices;
+
+    // Rebuild the active set from scratch, since every height may have changed
+    for (int v = 0; v < numVertices; v++) {
+        pr->currentArc[v] = network->offsets[v];
+        pr->active[v] = 0;
+        pr->bucketHead[v] = -1;
+    }
+    pr->head = pr->tail = 0;
+    pr->maxHeight = -1;
+    for (int v = 0; v < numVertices; v++) {
+        addActive(pr, v);
+    }
+    pr->relabels = 0;
+}
+
+// Function to raise `u` just above its lowest residual neighbour
+// If that empties the height `u` left, no vertex above the gap can reach the sink, so they all jump to V
+void relabel(struct PushRelabel *pr, int u) {
+    struct FlowNetwork *network = pr->network;
+    int numVertices = network->numVertices;
+    int oldHeight = pr->height[u];
+    int newHeight = numVertices;
+
+    for (int e = network->offsets[u]; e < network->offsets[u + 1]; e++) {
+        if (network->arcs[e].capacity > 0 && pr->height[network->arcs[e].to] + 1 < newHeight)
+            newHeight = pr->height[network->arcs[e].to] + 1;
+    }
+
+    pr->count[oldHeight]--;
+    if (pr->count[oldHeight] == 0) {
+        for (int v = 0; v < numVertices; v++) {
+            if (pr->height[v] > oldHeight && pr->height[v] < numVertices) {
+                pr->count[pr->height[v]]--;
+                pr->height[v] = numVertices;
+            }
+        }
+        newHeight = numVertices;
+    }
+
+    pr->height[u] = newHeight;
+    if (newHeight < numVertices)
+        pr->count[newHeight]++;
+    pr->currentArc[u] = network->offsets[u];
+    pr->relabels++;
+}
+
+// Function to push all of `u`'s excess downhill, relabelling whenever it runs out of admissible arcs
+void discharge(struct PushRelabel *pr, int u) {
+    struct FlowNetwork *network = pr->network;
+    struct Arc *arcs = network->arcs;
+    int numVertices = network->numVertices;
+
+    while (pr->excess[u] > 0 && pr->height[u] < numVertices) {
+        if (pr->currentArc[u] == network->offsets[u + 1]) {
+            relabel(pr, u);
+            continue;
+        }
+
+        int e = pr->currentArc[u];
+        int v = arcs[e].to;
+        if (arcs[e].capacity > 0 && pr->height[u] == pr->height[v] + 1) {
+            long long amount = pr->excess[u] < arcs[e].capacity ? pr->excess[u] : arcs[e].capacity;
+            arcs[e].capacity -= amount;
+            arcs[arcs[e].rev].capacity += amount;
+            pr->excess[u] -= amount;
+            pr->excess[v] += amount;
+            addActive(pr, v);
+        } else {
+            pr->currentArc[u]++;
+        }
+    }
+}
+
+// Function to implement the push-relabel algorithm with the gap heuristic and periodic global relabels
+long long pushRelabel(struct FlowNetwork *network, int source, int sink, int highestLabel) {
+    int numVertices = network->numVertices;
+    struct PushRelabel pr;
+    pr.network = network;
+    pr.source = source;
+    pr.sink = sink;
+    pr.highestLabel = highestLabel;
+    pr.height = (int *)malloc(numVertices * sizeof(int));
+    pr.excess = (long long *)calloc(numVertices, sizeof(long long));
+    pr.currentArc = (int *)malloc(numVertices * sizeof(int));
+    pr.count = (int *)calloc(numVertices + 1, sizeof(int));
+    pr.active = (char *)calloc(numVertices, sizeof(char));
+    pr.queue = (int *)malloc((numVertices + 1) * sizeof(int));
+    pr.bucketHead = (int *)malloc(numVertices * sizeof(int));
+    pr.bucketNext = (int *)malloc(numVertices * sizeof(int));
+
+    if (source != sink) {
+        // Saturate every arc out of the source to start the preflow
+        for (int e = network->offsets[source]; e < network->offsets[source + 1]; e++) {
+            long long amount = network->arcs[e].capacity;
+            network->arcs[e].capacity = 0;
+            network->arcs[network->arcs[e].rev].capacity += amount;
+            pr.excess[network->arcs[e].to] += amount;
+        }
+
+        globalRelabel(&pr);
+        int u;
+        while ((u = nextActive(&pr)) != -1) {
+            discharge(&pr, u);
+            if (pr.relabels >= numVertices)
+                globalRelabel(&pr);
+        }
+    }
+
+    long long maxFlow = pr.excess[sink];
+
+    // Free allocated memory after usage
+    free(pr.height);
+    free(pr.excess);
+    free(pr.currentArc);
+    free(pr.count);
+    free(pr.active);
+    free(pr.queue);
+    free(pr.bucketHead);
+    free(pr.bucketNext);
     return maxFlow;
 }
 
+// Structure to hold the state shared by the parallel push-relabel threads
+// Every vertex belongs to one thread (u % numThreads), and only that thread pushes from it or relabels it.
+// Pushes go to the lowest residual neighbour even if its height is stale, and every capacity and excess
+// update is atomic, which is enough for the lock-free scheme to stay correct
+struct ParallelPushRelabel {
+    struct FlowNetwork *network;
+    int source, sink;
+    int numThreads;
+    int budget; // Operations each thread does before everyone stops for a global relabel
+    _Atomic long long *residual;
+    _Atomic long long *excess;
+    _Atomic int *height;
+};
+
+// Structure to tell a parallel push-relabel thread which vertices are its own
+struct PushRelabelTask {
+    struct ParallelPushRelabel *shared;
+    int id;
+};
+
+// Worker thread that pushes and relabels its own active vertices until it runs out of work or budget
+void* pushRelabelWorker(void *arg) {
+    struct PushRelabelTask *task = (struct PushRelabelTask *)arg;
+    struct ParallelPushRelabel *shared = task->shared;
+    struct FlowNetwork *network = shared->network;
+    int numVertices = network->numVertices;
+    int operations = 0;
+
+    while (operations < shared->budget) {
+        int progress = 0;
+        for (int u = task->id; u < numVertices; u += shared->numThreads) {
+            if (u == shared->source || u == shared->sink)
+                continue;
+            long long excess = atomic_load(&shared->excess[u]);
+            int height = atomic_load_explicit(&shared->height[u], memory_order_relaxed);
+            if (excess <= 0 || height >= numVertices)
+                continue;
+            progress = 1;
+            operations++;
+
+            // Find the lowest neighbour that u can still push to
+            int lowest = INT_MAX, best = -1;
+            for (int e = network->offsets[u]; e < network->offsets[u + 1]; e++) {
+                if (atomic_load_explicit(&shared->residual[e], memory_order_relaxed) > 0) {
+                    int h = atomic_load_explicit(&shared->height[network->arcs[e].to], memory_order_relaxed);
+                    if (h < lowest) {
+                        lowest = h;
+                        best = e;
+                    }
+                }
+            }
+
+            if (best == -1) {
+                atomic_store_explicit(&shared->height[u], numVertices, memory_order_relaxed);
+            } else if (height > lowest) {
+                // Only u's thread takes capacity off u's arcs, so the amount read here is still there
+                long long room = atomic_load(&shared->residual[best]);
+                long long amount = excess < room ? excess : room;
+                atomic_fetch_sub(&shared->residual[best], amount);
+                atomic_fetch_add(&shared->residual[network->arcs[best].rev], amount);
+                atomic_fetch_sub(&shared->excess[u], amount);
+                atomic_fetch_add(&shared->excess[network->arcs[best].to], amount);
+            } else {
+                atomic_store_explicit(&shared->height[u], lowest + 1, memory_order_relaxed);
+            }
+        }
+        if (!progress)
+            break;
+    }
+    return NULL;
+}
+
+// Function to set every height to the residual distance to the sink while the threads are stopped
+// Returns 1 if any vertex still has excess it could send to the sink. Vertices cut off from the sink get
+// height V, which also covers what the gap heuristic would find
+int parallelGlobalRelabel(struct ParallelPushRelabel *shared, int *queue) {
+    struct FlowNetwork *network = shared->network;
+    int numVertices = network->numVertices;
+
+    for (int v = 0; v < numVertices; v++) {
+        atomic_store_explicit(&shared->height[v], numVertices, memory_order_relaxed);
+    }
+    int front = 0, rear = 0;
+    atomic_store_explicit(&shared->height[shared->sink], 0, memory_order_relaxed);
+    queue[rear++] = shared->sink;
+    while (front < rear) {
+        int v = queue[front++];
+        int next = atomic_load_explicit(&shared->height[v], memory_order_relaxed) + 1;
+        for (int e = network->offsets[v]; e < network->offsets[v + 1]; e++) {
+            int u = network->arcs[e].to;
+            if (u != shared->source && atomic_load_explicit(&shared->height[u], memory_order_relaxed) == numVertices
+                && atomic_load_explicit(&shared->residual[network->arcs[e].rev], memory_order_relaxed) > 0) {
+                atomic_store_explicit(&shared->height[u], next, memory_order_relaxed);
+                queue[rear++] = u;
+            }
+        }
+    }
+
+    for (int v = 0; v < numVertices; v++) {
+        if (v != shared->source && v != shared->sink && atomic_load(&shared->excess[v]) > 0
+            && atomic_load_explicit(&shared->height[v], memory_order_relaxed) < numVertices)
+            return 1;
+    }
+    return 0;
+}
+
+// Function to implement push-relabel with several threads working on active vertices at once
+// The threads run in rounds, and a global relabel between rounds keeps the heights tight
+long long parallelPushRelabel(struct FlowNetwork *network, int source, int sink, int numThreads) {
+    int numVertices = network->numVertices;
+    int numArcs = network->offsets[numVertices];
+    struct ParallelPushRelabel shared;
+    shared.network = network;
+    shared.source = source;
+    shared.sink = sink;
+    shared.numThreads = numThreads;
+    shared.budget = numVertices > 1024 ? numVertices : 1024;
+    shared.residual = (_Atomic long long *)malloc((numArcs + 1) * sizeof(_Atomic long long));
+    shared.excess = (_Atomic long long *)malloc(numVertices * sizeof(_Atomic long long));
+    shared.height = (_Atomic int *)malloc(numVertices * sizeof(_Atomic int));
+    for (int e = 0; e < numArcs; e++) {
+        atomic_init(&shared.residual[e], network->arcs[e].capacity);
+    }
+    for (int v = 0; v < numVertices; v++) {
+        atomic_init(&shared.excess[v], 0);
+        atomic_init(&shared.height[v], 0);
+    }
+
+    long long maxFlow = 0;
+    if (source != sink) {
+        // Saturate every arc out of the source to start the preflow
+        for (int e = network->offsets[source]; e < network->offsets[source + 1]; e++) {
+            long long amount = atomic_load(&shared.residual[e]);
+            atomic_store(&shared.residual[e], 0);
+            atomic_fetch_add(&shared.residual[network->arcs[e].rev], amount);
+            atomic_fetch_add(&shared.excess[network->arcs[e].to], amount);
+        }
+
+        int *queue = (int *)malloc(numVertices * sizeof(int));
+        pthread_t *threads = (pthread_t *)malloc(numThreads * sizeof(pthread_t));
+        struct PushRelabelTask *tasks = (struct PushRelabelTask *)malloc(numThreads * sizeof(struct PushRelabelTask));
+        while (parallelGlobalRelabel(&shared, queue)) {
+            for (int t = 0; t < numThreads; t++) {
+                tasks[t].shared = &shared;
+                tasks[t].id = t;
+                pthread_create(&threads[t], NULL, pushRelabelWorker, &tasks[t]);
+            }
+            for (int t = 0; t < numThreads; t++) {
+                pthread_join(threads[t], NULL);
+            }
+        }
+        free(queue);
+        free(threads);
+        free(tasks);
+        maxFlow = atomic_load(&shared.excess[sink]);
+    }
+
+    // Hand the residual capacities back so the min cut can be read off the network
+    for (int e = 0; e < numArcs; e++) {
+        network->arcs[e].capacity = atomic_load(&shared.residual[e]);
+    }
+
+    free(shared.residual);
+    free(shared.excess);
+    free(shared.height);
+    return maxFlow;
+}
+
+// Function to check whether the network is a unit-capacity bipartite matching problem
+// That means every edge with capacity goes source -> left, left -> right or right -> sink, and the source and
+// sink edges have capacity 1 (a left -> right edge may be repeated, since its left vertex still only gets one unit).
+// Returns side[v] (1 for left, 2 for right, 0 for neither) or NULL when the network has some other shape
+char* matchingSides(struct FlowNetwork *network, int source, int sink) {
+    int numVertices = network->numVertices;
+    struct Arc *arcs = network->arcs;
+    char *side = (char *)calloc(numVertices, sizeof(char));
+
+    // The left side is whatever the source feeds and the right side is whatever feeds the sink
+    for (int e = network->offsets[source]; e < network->offsets[source + 1]; e++) {
+        if (arcs[e].capacity > 0)
+            side[arcs[e].to] |= 1;
+    }
+    for (int e = network->offsets[sink]; e < network->offsets[sink + 1]; e++) {
+        if (arcs[arcs[e].rev].capacity > 0)
+            side[arcs[e].to] |= 2;
+    }
+
+    for (int u = 0; u < numVertices; u++) {
+        for (int e = network->offsets[u]; e < network->offsets[u + 1]; e++) {
+            if (arcs[e].capacity <= 0)
+                continue;
+            int v = arcs[e].to;
+            int fits = (u == source && v != sink && side[v] == 1) || (side[u] == 1 && side[v] == 2) ||
+                       (side[u] == 2 && v == sink);
+            int unit = arcs[e].capacity == 1 || (side[u] == 1 && side[v] == 2);
+            if (!unit || !fits || side[u] == 3 || side[v] == 3) {
+                free(side);
+                return NULL;
+            }
+        }
+    }
+    return side;
+}
+
+// Function to send one unit along the arc from u to v, used to write a matching back as a flow
+// The arc is looked up from whichever end has fewer arcs, so the source and sink are never scanned once per vertex
+void pushUnit(struct FlowNetwork *network, int u, int v) {
+    struct Arc *arcs = network->arcs;
+    int fromU = network->offsets[u + 1] - network->offsets[u] <= network->offsets[v + 1] - network->offsets[v];
+    int x = fromU ? u : v;
+    int y = fromU ? v : u;
+    for (int e = network->offsets[x]; e < network->offsets[x + 1]; e++) {
+        if (arcs[e].to == y) {
+            int forward = fromU ? e : arcs[e].rev;
+            arcs[forward].capacity--;
+            arcs[arcs[forward].rev].capacity++;
+            return;
+        }
+    }
+}
+
+// Function to implement the Hopcroft-Karp algorithm on a network that matchingSides accepted, in O(E sqrt(V))
+// Each phase finds the shortest augmenting path length with a BFS from the free left vertices, then a DFS
+// with current-arc pointers adds a maximal set of paths of that length. The matching is written back into
+// the residual graph at the end, so the min cut and incremental repairs work the same as after any engine
+long long hopcroftKarp(struct FlowNetwork *network, int source, int sink, char side[]) {
+    int numVertices = network->numVertices;
+    struct Arc *arcs = network->arcs;
+    int *mate = (int *)malloc(numVertices * sizeof(int)); // Partner of a left or right vertex, or -1
+    int *dist = (int *)malloc(numVertices * sizeof(int));
+    int *current = (int *)malloc(numVertices * sizeof(int));
+    int *queue = (int *)malloc(numVertices * sizeof(int));
+    int *stack = (int *)malloc(numVertices * sizeof(int));
+    long long matching = 0;
+
+    for (int v = 0; v < numVertices; v++) {
+        mate[v] = -1;
+    }
+
+    while (1) {
+        // Layer the left vertices by how many matched edges separate them from a free left vertex
+        int front = 0, rear = 0, found = 0;
+        for (int u = 0; u < numVertices; u++) {
+            dist[u] = INT_MAX;
+            if (side[u] == 1 && mate[u] == -1) {
+                dist[u] = 0;
+                queue[rear++] = u;
+            }
+        }
+        while (front < rear) {
+            int u = queue[front++];
+            for (int e = network->offsets[u]; e < network->offsets[u + 1]; e++) {
+                int r = arcs[e].to;
+                if (arcs[e].capacity <= 0 || side[r] != 2)
+                    continue;
+                if (mate[r] == -1) {
+                    found = 1;
+                } else if (dist[mate[r]] == INT_MAX) {
+                    dist[mate[r]] = dist[u] + 1;
+                    queue[rear++] = mate[r];
+                }
+            }
+        }
+        if (!found)
+            break;
+
+        // Follow the layers down from every free left vertex until a free right vertex turns up
+        for (int u = 0; u < numVertices; u++) {
+            current[u] = network->offsets[u];
+        }
+        for (int start = 0; start < numVertices; start++) {
+            if (side[start] != 1 || mate[start] != -1)
+                continue;
+            int top = 0;
+            stack[top++] = start;
+            while (top > 0) {
+                int u = stack[top - 1];
+                if (current[u] == network->offsets[u + 1]) {
+                    dist[u] = INT_MAX; // Dead end for the rest of this phase
+                    top--;
+                    continue;
+                }
+                int e = current[u];
+                int r = arcs[e].to;
+                if (arcs[e].capacity <= 0 || side[r] != 2) {
+                    current[u]++;
+                } else if (mate[r] == -1) {
+                    // Flip the path: every left vertex on the stack takes the right vertex it points at
+                    for (int i = top - 1; i >= 0; i--) {
+                        int l = stack[i];
+                        int m = arcs[current[l]].to;
+                        mate[l] = m;
+                        mate[m] = l;
+                    }
+                    matching++;
+                    top = 0;
+                } else if (dist[mate[r]] == dist[u] + 1) {
+                    stack[top++] = mate[r];
+                } else {
+                    current[u]++;
+                }
+            }
+        }
+    }
+
+    // Send one unit through every matched pair so the residual graph holds the flow
+    for (int u = 0; u < numVertices; u++) {
+        if (side[u] == 1 && mate[u] != -1) {
+            pushUnit(network, source, u);
+            pushUnit(network, u, mate[u]);
+            pushUnit(network, mate[u], sink);
+        }
+    }
+
+    free(mate);
+    free(dist);
+    free(current);
+    free(queue);
+    free(stack);
+    return matching;
+}
+
+// Function to print the edges of a minimum cut after any engine has run
+// The sink side is every vertex that can still reach the sink in the residual graph, and the cut is every
+// edge from the other side into it, listed with its original capacity
+void printMinCut(struct FlowNetwork *network, int sink, long long originalCapacity[]) {
+    int numVertices = network->numVertices;
+    struct Arc *arcs = network->arcs;
+    char *sinkSide = (char *)calloc(numVertices, sizeof(char));
+    int *queue = (int *)malloc(numVertices * sizeof(int));
+
+    int front = 0, rear = 0;
+    sinkSide[sink] = 1;
+    queue[rear++] = sink;
+    while (front < rear) {
+        int v = queue[front++];
+        for (int e = network->offsets[v]; e < network->offsets[v + 1]; e++) {
+            int u = arcs[e].to;
+            if (!sinkSide[u] && arcs[arcs[e].rev].capacity > 0) {
+                sinkSide[u] = 1;
+                queue[rear++] = u;
+            }
+        }
+    }
+
+    int cutEdges = 0;
+    for (int u = 0; u < numVertices; u++) {
+        for (int e = network->offsets[u]; e < network->offsets[u + 1]; e++) {
+            if (!sinkSide[u] && sinkSide[arcs[e].to] && originalCapacity[e] > 0)
+                cutEdges++;
+        }
+    }
+    printf("Min Cut Edges: %d\n", cutEdges);
+    for (int u = 0; u < numVertices; u++) {
+        for (int e = network->offsets[u]; e < network->offsets[u + 1]; e++) {
+            if (!sinkSide[u] && sinkSide[arcs[e].to] && originalCapacity[e] > 0)
+                printf("%d %d %lld\n", u, arcs[e].to, originalCapacity[e]);
+        }
+    }
+
+    free(sinkSide);
+    free(queue);
+}
+
+// Function to find the arc u -> v, or -1 if u and v share no arc pair
+int findArc(struct FlowNetwork *network, int u, int v) {
+    for (int e = network->offsets[u]; e < network->offsets[u + 1]; e++) {
+        if (network->arcs[e].to == v)
+            return e;
+    }
+    return -1;
+}
+
+// Function to read the current flow value as the net flow into the sink
+long long flowIntoSink(struct FlowNetwork *network, int sink, long long capacity[]) {
+    long long flow = 0;
+    for (int e = network->offsets[sink]; e < network->offsets[sink + 1]; e++) {
+        flow += network->arcs[e].capacity - capacity[e]; // Flow leaving the sink on e counts against it
+    }
+    return flow;
+}
+
+// Function to keep a maximum flow up to date while `u v newCapacity` updates stream in on stdin
+// `capacity` holds the current capacity of every arc, and the network holds the residual graph of a maximum flow.
+// Raising a capacity only needs new augmenting paths. Lowering it below the flow on the arc leaves that much
+// surplus at u and deficit at v: first it is rerouted from u to v, whatever cannot be rerouted is sent from u
+// back to the source and from the sink back to v, and then the flow is augmented to a maximum again
+void incrementalFlow(struct FlowNetwork *network, int source, int sink, long long capacity[]) {
+    int numVertices = network->numVertices;
+    struct Arc *arcs = network->arcs;
+    int *parentArc = (int *)malloc(numVertices * sizeof(int));
+    int *visited = (int *)malloc(numVertices * sizeof(int));
+    int *queue = (int *)malloc(numVertices * sizeof(int));
+
+    int u, v;
+    long long newCapacity;
+    while (scanf("%d %d %lld", &u, &v, &newCapacity) == 3) {
+        int e = (u >= 0 && u < numVertices && v >= 0 && v < numVertices && u != v) ? findArc(network, u, v) : -1;
+        if (e == -1 || newCapacity < 0) {
+            fprintf(stderr, "Cannot set edge %d %d to %lld, it is not in the network.\n", u, v, newCapacity);
+            continue;
+        }
+
+        arcs[e].capacity += newCapacity - capacity[e];
+        capacity[e] = newCapacity;
+
+        if (arcs[e].capacity < 0) {
+            // The arc now carries more than it may, so take the overflow off it
+            long long overflow = -arcs[e].capacity;
+            arcs[e].capacity = 0;
+            arcs[arcs[e].rev].capacity -= overflow;
+
+            long long left = overflow - augmentPaths(network, u, v, overflow, parentArc, visited, queue);
+            if (left > 0 && u != source && u != sink)
+                augmentPaths(network, u, source, left, parentArc, visited, queue);
+            if (left > 0 && v != source && v != sink)
+                augmentPaths(network, sink, v, left, parentArc, visited, queue);
+        }
+
+        augmentPaths(network, source, sink, LLONG_MAX, parentArc, visited, queue);
+        printf("Maximum Flow: %lld\n", flowIntoSink(network, sink, capacity));
+        fflush(stdout);
+    }
+
+    free(parentArc);
+    free(visited);
+    free(queue);
+}
+
 // Function to print the file or the first 10 lines if too large
 void printFile(const char *fileName) {
     FILE *file = fopen(fileName, "r");
@@ -100,37 +983,131 @@ void printFile(const char *fileName) {
     fclose(file);
 }
 
+// Function to print how to run the program
+void printUsage(const char *program) {
+    printf("Usage: %s <source> <sink> [--engine edmonds-karp|dinic|push-relabel|hopcroft-karp] [--scaling]\n", program);
+    printf("       [--selection fifo|highest] [--threads n] [--min-cut] [--incremental] < <inputfile>\n");
+}
+
 int main(int argc, char *argv[]) {
     if (argc < 3) {
         if (argc == 2) {
             // No source and sink provided, print the input file contents
             printFile(argv[1]);
         } else {
-            printf("Usage: %s <source> <sink> < <inputfile>\n", argv[0]);
+            printUsage(argv[0]);
         }
         return 0;
     }
 
     int source = atoi(argv[1]);
     int sink = atoi(argv[2]);
+
+    // Pick the max-flow engine, Edmonds-Karp stays the default unless the input is a unit bipartite matching
+    const char *engine = NULL;
+    int scaling = 0;
+    int highestLabel = 1; // Push-relabel vertex selection
+    int numThreads = 1;   // More than one picks the parallel push-relabel
+    int minCut = 0;
+    int incremental = 0;  // Keep the flow and repair it as capacity updates arrive after the network
+    for (int i = 3; i < argc; i++) {
+        if (strcmp(argv[i], "--engine") == 0 && i + 1 < argc) {
+            engine = argv[++i];
+        } else if (strcmp(argv[i], "--scaling") == 0) {
+            scaling = 1;
+        } else if (strcmp(argv[i], "--selection") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "fifo") == 0) {
+                highestLabel = 0;
+            } else if (strcmp(argv[i], "highest") == 0) {
+                highestLabel = 1;
+            } else {
+                fprintf(stderr, "Unknown selection %s, expected fifo or highest.\n", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            numThreads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--min-cut") == 0) {
+            minCut = 1;
+        } else if (strcmp(argv[i], "--incremental") == 0) {
+            incremental = 1;
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    if (engine != NULL && strcmp(engine, "edmonds-karp") != 0 && strcmp(engine, "dinic") != 0 &&
+        strcmp(engine, "push-relabel") != 0 && strcmp(engine, "hopcroft-karp") != 0) {
+        fprintf(stderr, "Unknown engine %s, expected edmonds-karp, dinic, push-relabel or hopcroft-karp.\n", engine);
+        return 1;
+    }
+    if (numThreads < 1)
+        numThreads = 1;
+    if (incremental && engine != NULL && strcmp(engine, "push-relabel") == 0) {
+        fprintf(stderr, "Incremental mode needs a complete flow to repair, use edmonds-karp or dinic.\n");
+        return 1;
+    }
     
     int V, E;
-    scanf("%d %d", &V, &E);
-    
-    int graph[MAX_VERTICES][MAX_VERTICES] = {0};
+    if (scanf("%d %d", &V, &E) != 2) {
+        fprintf(stderr, "Error reading number of vertices and edges.\n");
+        return 1;
+    }
+    if (source < 0 || source >= V || sink < 0 || sink >= V) {
+        fprintf(stderr, "Source or sink is out of range.\n");
+        return 1;
+    }
     
-    // Read the edges and capacities
-    for (int i = 0; i < E; i++) {
-        int u, v, capacity;
-        scanf("%d %d %d", &u, &v, &capacity);
-        graph[u][v] += capacity;  // Handling multiple edges between two vertices
+    // Read the edges into a sparse residual graph, merging parallel edges
+    struct FlowNetwork *network = readNetwork(V, E);
+
+    // The cut is reported with the capacities from the input, so keep them before the flow changes them
+    long long *originalCapacity = NULL;
+    if (minCut || incremental) {
+        int numArcs = network->offsets[V];
+        originalCapacity = (long long *)malloc((numArcs + 1) * sizeof(long long));
+        for (int e = 0; e < numArcs; e++) {
+            originalCapacity[e] = network->arcs[e].capacity;
+        }
     }
     
+    // Matching inputs go to Hopcroft-Karp on their own, and asking for it on anything else is an error
+    char *side = NULL;
+    if (engine == NULL || strcmp(engine, "hopcroft-karp") == 0) {
+        side = matchingSides(network, source, sink);
+        if (side == NULL && engine != NULL) {
+            fprintf(stderr, "Hopcroft-Karp needs a unit-capacity bipartite network from the source to the sink.\n");
+            return 1;
+        }
+        engine = side != NULL ? "hopcroft-karp" : "edmonds-karp";
+    }
+
     // Calculate maximum flow
-    int maxFlow = edmondsKarp(graph, source, sink, V);
+    long long maxFlow;
+    if (side != NULL)
+        maxFlow = hopcroftKarp(network, source, sink, side);
+    else if (strcmp(engine, "dinic") == 0)
+        maxFlow = dinic(network, source, sink, scaling);
+    else if (strcmp(engine, "push-relabel") == 0 && numThreads > 1)
+        maxFlow = parallelPushRelabel(network, source, sink, numThreads);
+    else if (strcmp(engine, "push-relabel") == 0)
+        maxFlow = pushRelabel(network, source, sink, highestLabel);
+    else
+        maxFlow = edmondsKarp(network, source, sink);
     
     // Output the maximum flow value
-    printf("Maximum Flow: %d\n", maxFlow);
+    printf("Maximum Flow: %lld\n", maxFlow);
+
+    if (minCut)
+        printMinCut(network, sink, originalCapacity);
+
+    // In incremental mode every line after the network is a `u v newCapacity` update
+    if (incremental)
+        incrementalFlow(network, source, sink, originalCapacity);
+
+    free(originalCapacity);
+    free(side);
     
+    freeNetwork(network);
     return 0;
 }
@@ -5,171 +5,225 @@
 #include <string.h>
 #include <time.h>
 
-typedef struct DPEntry {
-    unsigned long long hash_value;
-    bool result;
-    struct DPEntry *next;
-} DPEntry;
-
-#define HASH_MAP_SIZE 100003  // Large prime for hash map size
-
-DPEntry *hash_map[HASH_MAP_SIZE];  // Global hash map
-
-// Hash function
-unsigned long long hash(int *assignments, int num_vars) {
-    unsigned long long hash_value = 0;
-    for (int i = 0; i < num_vars; i++) {
-        hash_value = (hash_value * 31) + (assignments[i] + 1);  // Encode -1, 0, 1 as 0, 1, 2
-    }
-    return hash_value % HASH_MAP_SIZE;
-}
-
-// Insert into hash map
-void insert(int *assignments, int num_vars, bool result) {
-    unsigned long long h = hash(assignments, num_vars);
-    DPEntry *new_entry = (DPEntry *)malloc(sizeof(DPEntry));
-    new_entry->hash_value = h;
-    new_entry->result = result;
-    new_entry->next = hash_map[h];
-    hash_map[h] = new_entry;
+// A literal is +v or -v for variable v (1-based), and is stored as index 2 * (v - 1), plus 1 when negated
+#define LIT_INDEX(lit) (2 * (abs(lit) - 1) + ((lit) < 0))
+
+// List of the clauses watching one literal
+typedef struct {
+    int *clauses;
+    int count;
+    int capacity;
+} WatchList;
+
+// Solver state: every clause watches two of its literals, the first two it stores, and is only looked at when one
+// of them becomes false. The trail lists the literals made true, in order, so backtracking just truncates it
+typedef struct {
+    int num_vars;
+    int num_clauses;
+    int **clauses;
+    int *clause_size;     // 1 to 3 literals once duplicates are merged
+    WatchList *watches;   // Indexed by LIT_INDEX of the watched literal
+    int *assignments;     // -1 unassigned, 0 false, 1 true
+    int *trail;
+    int trail_size;
+    int propagated;       // Trail entries before this one have had their watches processed
+    int *order;           // Variables by how many clauses they appear in, most first
+} Solver;
+
+// Value of a literal under the current assignment: -1 unassigned, 0 false, 1 true
+int literal_value(Solver *s, int lit) {
+    int value = s->assignments[abs(lit) - 1];
+    if (value == -1) return -1;
+    return lit > 0 ? value : !value;
 }
 
-// Search in hash map
-bool search(int *assignments, int num_vars, bool *result) {
-    unsigned long long h = hash(assignments, num_vars);
-    DPEntry *current = hash_map[h];
-    while (current) {
-        if (current->hash_value == h) {
-            *result = current->result;
-            return true;
-        }
-        current = current->next;
+void add_watch(Solver *s, int lit, int clause) {
+    WatchList *list = &s->watches[LIT_INDEX(lit)];
+    if (list->count == list->capacity) {
+        list->capacity = list->capacity ? 2 * list->capacity : 4;
+        list->clauses = (int *)realloc(list->clauses, list->capacity * sizeof(int));
     }
-    return false;
+    list->clauses[list->count++] = clause;
 }
 
-// Evaluate a single clause
-bool evaluate_clause(int clause[3], int *assignments) {
-    for (int i = 0; i < 3; i++) {
-        int var = abs(clause[i]);
-        int value = assignments[var - 1];
-        if ((clause[i] > 0 && value == 1) || (clause[i] < 0 && value == 0)) {
-            return true;
-        }
-    }
-    return false;
+// Make a literal true and put it on the trail
+void assign_literal(Solver *s, int lit) {
+    s->assignments[abs(lit) - 1] = lit > 0;
+    s->trail[s->trail_size++] = lit;
 }
 
-// Check if all clauses are satisfied
-bool all_clauses_satisfied(int **clauses, int num_clauses, int *assignments) {
-    for (int i = 0; i < num_clauses; i++) {
-        if (!evaluate_clause(clauses[i], assignments)) {
-            return false;
-        }
+// Undo every assignment made after the trail had `size` entries
+void backtrack(Solver *s, int size) {
+    while (s->trail_size > size) {
+        s->assignments[abs(s->trail[--s->trail_size]) - 1] = -1;
     }
-    return true;
+    if (s->propagated > size) s->propagated = size;
 }
 
-// Check for unsatisfied clauses
-bool any_clause_unsatisfied(int **clauses, int num_clauses, int *assignments) {
-    for (int i = 0; i < num_clauses; i++) {
-        if (!evaluate_clause(clauses[i], assignments)) {
-            bool partially_unsat = true;
-            for (int j = 0; j < 3; j++) {
-                int var = abs(clauses[i][j]);
-                //printf("Evaluating var %d of clause #%d currently %d\n",clauses[i][j],i+1,assignments[var - 1]);
-                if (assignments[var - 1] == -1) {
-                    partially_unsat = false;
+// Unit propagation: for every literal on the trail not yet processed, visit only the clauses watching its negation.
+// Each one either is already true through its other watch, moves the watch to a literal that is not false,
+// forces its other watch to be true, or has every literal false. Returns false on such a conflict
+bool propagate(Solver *s) {
+    while (s->propagated < s->trail_size) {
+        int false_lit = -s->trail[s->propagated++];
+        WatchList *list = &s->watches[LIT_INDEX(false_lit)];
+        int kept = 0;
+        for (int i = 0; i < list->count; i++) {
+            int c = list->clauses[i];
+            int *clause = s->clauses[c];
+
+            // Keep the false literal second, so clause[0] is the other watch
+            if (clause[0] == false_lit) {
+                clause[0] = clause[1];
+                clause[1] = false_lit;
+            }
+            if (literal_value(s, clause[0]) == 1) {
+                list->clauses[kept++] = c;
+                continue;
+            }
+
+            // Look for a replacement watch among the rest of the clause
+            bool moved = false;
+            for (int j = 2; j < s->clause_size[c]; j++) {
+                if (literal_value(s, clause[j]) != 0) {
+                    clause[1] = clause[j];
+                    clause[j] = false_lit;
+                    add_watch(s, clause[1], c);
+                    moved = true;
                     break;
                 }
             }
-            if (partially_unsat) return true;
+            if (moved) continue;
+
+            list->clauses[kept++] = c;
+            if (literal_value(s, clause[0]) == 0) {
+                // Conflict: keep the watches not looked at yet and stop
+                for (i++; i < list->count; i++) {
+                    list->clauses[kept++] = list->clauses[i];
+                }
+                list->count = kept;
+                return false;
+            }
+            assign_literal(s, clause[0]);
         }
+        list->count = kept;
     }
-    return false;
+    return true;
 }
 
-// Most Constrained Variable heuristic
-int select_most_constrained_variable(int **clauses, int num_clauses, int *assignments, int num_vars) {
+// Function to load the clauses into the solver, merging repeated literals, dropping clauses that contain a literal
+// and its negation, and watching the first two literals of the rest. Returns false if the unit clauses conflict
+bool init_solver(Solver *s, int **clauses, int num_clauses, int num_vars) {
+    s->num_vars = num_vars;
+    s->num_clauses = num_clauses;
+    s->clauses = clauses;
+    s->clause_size = (int *)malloc(num_clauses * sizeof(int));
+    s->watches = (WatchList *)calloc(2 * num_vars, sizeof(WatchList));
+    s->assignments = (int *)malloc(num_vars * sizeof(int));
+    memset(s->assignments, -1, num_vars * sizeof(int));
+    s->trail = (int *)malloc(num_vars * sizeof(int));
+    s->trail_size = 0;
+    s->propagated = 0;
+
+    // Most Constrained Variable heuristic, counted once over all clauses: branch on the variables that appear most
     int *freq = (int *)calloc(num_vars, sizeof(int));
-
-    // Count frequency of unassigned variables in unresolved clauses
+    bool consistent = true;
     for (int i = 0; i < num_clauses; i++) {
+        int *clause = clauses[i];
+        int size = 0;
+        bool tautology = false;
         for (int j = 0; j < 3; j++) {
-            int var = abs(clauses[i][j]) - 1;
-            if (assignments[var] == -1) {
-                freq[var]++;
+            bool repeated = false;
+            for (int m = 0; m < size; m++) {
+                if (clause[m] == clause[j]) repeated = true;
+                if (clause[m] == -clause[j]) tautology = true;
             }
+            if (!repeated) clause[size++] = clause[j];
         }
-    }
+        s->clause_size[i] = tautology ? 0 : size;
+        if (tautology) continue;
 
-    // Find the variable with the highest frequency
-    int max_freq = -1;
-    int chosen_var = -1;
-    for (int i = 0; i < num_vars; i++) {
-        if (assignments[i] == -1 && freq[i] >= max_freq) {
-            max_freq = freq[i];
-            chosen_var = i;
+        for (int j = 0; j < size; j++) {
+            freq[abs(clause[j]) - 1]++;
+        }
+        if (size >= 2) {
+            add_watch(s, clause[0], i);
+            add_watch(s, clause[1], i);
+        } else if (literal_value(s, clause[0]) == -1) {
+            assign_literal(s, clause[0]);
+        } else if (literal_value(s, clause[0]) == 0) {
+            consistent = false;
         }
     }
 
+    s->order = (int *)malloc(num_vars * sizeof(int));
+    for (int i = 0; i < num_vars; i++) {
+        s->order[i] = i;
+    }
+    // Counting sort by frequency, most frequent first
+    int max_freq = 0;
+    for (int i = 0; i < num_vars; i++) {
+        if (freq[i] > max_freq) max_freq = freq[i];
+    }
+    int *start = (int *)calloc(max_freq + 2, sizeof(int));
+    for (int i = 0; i < num_vars; i++) {
+        start[max_freq - freq[i] + 1]++;
+    }
+    for (int f = 1; f <= max_freq + 1; f++) {
+        start[f] += start[f - 1];
+    }
+    for (int i = 0; i < num_vars; i++) {
+        s->order[start[max_freq - freq[i]]++] = i;
+    }
+    free(start);
     free(freq);
-    //printf("%d is currently the most problemmatic\n",chosen_var+1);
-    return chosen_var;
+    return consistent;
 }
 
-// DPLL algorithm with memoization and heuristic
-bool dpll(int **clauses, int num_clauses, int *assignments, int num_vars) {
-    // Check memoized result
-    bool result;
-    if (search(assignments, num_vars, &result)) {
-        //printf("Memoized result found for current assignment. Returning: %s\n", result ? "true" : "false");
-        return result;
+void free_solver(Solver *s) {
+    for (int i = 0; i < 2 * s->num_vars; i++) {
+        free(s->watches[i].clauses);
     }
+    free(s->watches);
+    free(s->clause_size);
+    free(s->assignments);
+    free(s->trail);
+    free(s->order);
+}
 
-    // Base cases
-    if (all_clauses_satisfied(clauses, num_clauses, assignments)) {
-        //printf("All clauses satisfied with current assignment. Returning: true\n");
-        insert(assignments, num_vars, true);
-        return true;
-    }
-    if (any_clause_unsatisfied(clauses, num_clauses, assignments)) {
-        //printf("At least one clause unsatisfied with current assignment. Returning: false\n");
-        //insert(assignments, num_vars, false);
+// DPLL algorithm with unit propagation
+// Every variable in order[0, next) is already assigned, so the search for the next one to branch on picks up there
+bool dpll(Solver *s, int next) {
+    if (!propagate(s)) {
         return false;
     }
 
     // Select the next variable using heuristic
-    int var = select_most_constrained_variable(clauses, num_clauses, assignments, num_vars);
-
-    if (var == -1) {
-        //printf("No variable selected. Likely no unassigned variables remain. Returning: false\n");
-        return false;
+    while (next < s->num_vars && s->assignments[s->order[next]] != -1) {
+        next++;
     }
+    if (next == s->num_vars) {
+        // Everything is assigned without a conflict, so every clause is satisfied
+        return true;
+    }
+    int var = s->order[next];
+    int saved = s->trail_size;
 
     // Try assigning true
-    //printf("Setting variable %d to true and attempting recursion.\n", var);
-    assignments[var] = 1;
-    if (dpll(clauses, num_clauses, assignments, num_vars)) {
-        //printf("Recursion successful with variable %d set to true. Returning: true\n", var);
-        insert(assignments, num_vars, true);
+    assign_literal(s, var + 1);
+    if (dpll(s, next + 1)) {
         return true;
     }
+    backtrack(s, saved);
 
     // Try assigning false
-    //printf("Setting variable %d to false and attempting recursion.\n", var);
-    assignments[var] = 0;
-    if (dpll(clauses, num_clauses, assignments, num_vars)) {
-       //printf("Recursion successful with variable %d set to false. Returning: true\n", var);
-        insert(assignments, num_vars, true);
+    assign_literal(s, -(var + 1));
+    if (dpll(s, next + 1)) {
         return true;
     }
 
     // Backtrack
-    //printf("Backtracking on variable %d. Setting to unassigned (-1).\n", var);
-    assignments[var] = -1;
-    insert(assignments, num_vars, true);
-    //printf("Backtracked completely on variable %d. Returning: false\n", var);
+    backtrack(s, saved);
     return false;
 }
 
@@ -198,14 +252,12 @@ int main(int argc, char *argv[]) {
     }
     fclose(file);
 
-    // Initialize assignments (-1 means unassigned)
-    int *assignments = (int *)malloc(num_vars * sizeof(int));
-    memset(assignments, -1, num_vars * sizeof(int));
-
     clock_t start_time = clock();
 
-    // Solve using DPLL
-    bool is_satisfiable = dpll(clauses, num_clauses, assignments, num_vars);
+    // Solve using DPLL, after loading the clauses and their watches
+    Solver solver;
+    bool is_satisfiable = init_solver(&solver, clauses, num_clauses, num_vars) && dpll(&solver, 0);
+    int *assignments = solver.assignments;
 
     clock_t end_time = clock();
     double elapsed_time = (double)(end_time - start_time) / CLOCKS_PER_SEC;
@@ -226,7 +278,7 @@ int main(int argc, char *argv[]) {
         free(clauses[i]);
     }
     free(clauses);
-    free(assignments);
+    free_solver(&solver);
 
     return 0;
 }